@@ -0,0 +1,173 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "EffectSystem/M2AttributeAggregator.h"
+
+#include "Algo/Sort.h"
+#include "EffectSystem/M2Attribute.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+void UM2AttributeAggregator::Initialize(UM2Registry* Registry)
+{
+	CachedBuffer = Registry->GetShared<UM2AttributeModifierBuffer>();
+}
+
+void UM2AttributeAggregator::PerformOperation(FM2OperationContext& Ctx)
+{
+	SCOPE_CYCLE_COUNTER(STAT_M2_AttributeAggregator);
+	
+	// This can run on a worker thread, so the buffer must already exist (see Initialize).
+	UM2AttributeModifierBuffer* Buffer = CachedBuffer.Get();
+	if (!Buffer)
+	{
+		M2_LOG(LogM2, Error, TEXT("Attribute modifier buffer is missing."));
+		return;
+	}
+
+	TArray<FM2AttributeModifier>& Modifiers = Buffer->GetModifiers();
+	if (Modifiers.IsEmpty())
+	{
+		return;
+	}
+
+	// Resolve each target to its set and current index up front. Modifiers whose target has since been removed are dropped.
+	ResolvedModifiers.Reset(Modifiers.Num());
+	UM2RecordSet* LastRecordSet = nullptr;
+	
+	for (const FM2AttributeModifier& Modifier : Modifiers)
+	{
+		if (!LastRecordSet || !LastRecordSet->HasRecord(Modifier.Target))
+		{
+			LastRecordSet = Ctx.Registry->GetRecordSet(Modifier.Target);
+		}
+		const int32 RecordIndex = LastRecordSet ? LastRecordSet->GetRecordIndex(Modifier.Target) : INDEX_NONE;
+		if (RecordIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		FResolvedModifier& Resolved = ResolvedModifiers.AddDefaulted_GetRef();
+		Resolved.RecordSet = LastRecordSet;
+		Resolved.Attribute = Modifier.Attribute;
+		Resolved.RecordIndex = RecordIndex;
+		Resolved.Op = Modifier.Op;
+		Resolved.Magnitude = Modifier.Magnitude;
+	}
+	Buffer->Reset();
+
+	// Sorting on every member (including the magnitude) makes the floating point results independent of emit order.
+	Algo::Sort(ResolvedModifiers, [](const FResolvedModifier& A, const FResolvedModifier& B)
+	{
+		if (A.RecordSet != B.RecordSet)
+		{
+			return A.RecordSet < B.RecordSet;
+		}
+		if (A.Attribute != B.Attribute)
+		{
+			return A.Attribute < B.Attribute;
+		}
+		if (A.RecordIndex != B.RecordIndex)
+		{
+			return A.RecordIndex < B.RecordIndex;
+		}
+		if (A.Op != B.Op)
+		{
+			return A.Op < B.Op;
+		}
+		return A.Magnitude < B.Magnitude;
+	});
+
+	TArrayView<FM2Attribute> AttributeArray;
+	int32 NumApplied = 0;
+	
+	for (int32 ModifierIndex = 0; ModifierIndex < ResolvedModifiers.Num();)
+	{
+		const FResolvedModifier& First = ResolvedModifiers[ModifierIndex];
+		
+		// Only look up the attribute column when moving on to a new set or attribute.
+		if (ModifierIndex == 0 || First.RecordSet != ResolvedModifiers[ModifierIndex - 1].RecordSet || First.Attribute != ResolvedModifiers[ModifierIndex - 1].Attribute)
+		{
+			AttributeArray = First.RecordSet->GetFieldArrayAs<FM2Attribute>(First.Attribute);
+			if (!AttributeArray.GetData())
+			{
+				bool bAlreadyWarned = false;
+				WarnedMissingFields.Add(TPair<UM2RecordSet*, UScriptStruct*>(First.RecordSet, First.Attribute), &bAlreadyWarned);
+				if (!bAlreadyWarned)
+				{
+					M2_LOG(LogM2, Warning, TEXT("Record set %s has no attribute field %s."), *First.RecordSet->GetName(), *First.Attribute->GetName());
+				}
+			}
+		}
+
+		float SumAdd = 0.0f;
+		float ProductMultiply = 1.0f;
+		bool bOverride = false;
+		float OverrideValue = 0.0f;
+
+		int32 EndIndex = ModifierIndex;
+		for (; EndIndex < ResolvedModifiers.Num(); ++EndIndex)
+		{
+			const FResolvedModifier& Modifier = ResolvedModifiers[EndIndex];
+			if (Modifier.RecordSet != First.RecordSet || Modifier.Attribute != First.Attribute || Modifier.RecordIndex != First.RecordIndex)
+			{
+				break;
+			}
+
+			switch (Modifier.Op)
+			{
+			case EM2AttributeModifierOp::Add:
+				SumAdd += Modifier.Magnitude;
+				break;
+			case EM2AttributeModifierOp::Multiply:
+				ProductMultiply *= Modifier.Magnitude;
+				break;
+			case EM2AttributeModifierOp::Override:
+				// Overrides are sorted by magnitude, so the last one is the largest.
+				bOverride = true;
+				OverrideValue = Modifier.Magnitude;
+				break;
+			}
+		}
+
+		if (AttributeArray.IsValidIndex(First.RecordIndex))
+		{
+			float& Value = AttributeArray[First.RecordIndex].Value;
+			Value = bOverride ? OverrideValue : (Value + SumAdd) * ProductMultiply;
+			NumApplied += EndIndex - ModifierIndex;
+		}
+
+		ModifierIndex = EndIndex;
+	}
+
+	INC_DWORD_STAT_BY(STAT_M2_AttributeModifiersApplied, NumApplied);
+	ResolvedModifiers.Reset();
+}
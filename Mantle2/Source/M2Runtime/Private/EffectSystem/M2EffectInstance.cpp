@@ -31,7 +31,336 @@
 
 #include "EffectSystem/M2EffectInstance.h"
 
+#include "EffectSystem/M2Effect.h"
+
 void UM2EffectInstance::Initialize()
 {
 	M2_INITIALIZE_FIELD(FM2EffectMetadata, Metadata);
-}
\ No newline at end of file
+	M2_INITIALIZE_FIELD(FInstancedStruct, Payload);
+
+	RebuildIndices();
+}
+
+FM2RecordHandle UM2EffectInstance::AddEffect(const FM2EffectMetadata& InMetadata)
+{
+	FM2RecordHandle StackedHandle = StackEffect(InMetadata);
+	if (StackedHandle.IsSet())
+	{
+		return StackedHandle;
+	}
+	
+	int32 RecordIndex;
+	FM2RecordHandle EffectHandle = AddRecordInternal(RecordIndex);
+
+	FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+	EffectMetadata = InMetadata;
+	EffectMetadata.bIndexed = false;
+	IndexEffect(EffectHandle, EffectMetadata);
+	
+	return EffectHandle;
+}
+
+FM2RecordHandle UM2EffectInstance::AddEffect(const FM2EffectMetadata& InMetadata, const FInstancedStruct& InPayload)
+{
+	FM2RecordHandle StackedHandle = StackEffect(InMetadata, FM2RecordHandle(), &InPayload);
+	if (StackedHandle.IsSet())
+	{
+		return StackedHandle;
+	}
+	
+	int32 RecordIndex;
+	FM2RecordHandle EffectHandle = AddRecordInternal(RecordIndex);
+
+	Payload[RecordIndex] = InPayload;
+
+	FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+	EffectMetadata = InMetadata;
+	EffectMetadata.bIndexed = false;
+	IndexEffect(EffectHandle, EffectMetadata);
+	
+	return EffectHandle;
+}
+
+FM2RecordHandle UM2EffectInstance::StackEffect(
+	const FM2EffectMetadata& InMetadata,
+	const FM2RecordHandle& IgnoreHandle,
+	const FInstancedStruct* InPayload
+)
+{
+	if (!InMetadata.Effect || !InMetadata.Target.IsSet())
+	{
+		return FM2RecordHandle();
+	}
+
+	const UM2Effect* EffectDefaults = InMetadata.Effect->GetDefaultObject<UM2Effect>();
+	if (!EffectDefaults || EffectDefaults->StackingPolicy == EM2EffectStackingPolicy::Independent)
+	{
+		return FM2RecordHandle();
+	}
+
+	FM2RecordHandle StackedHandle;
+	
+	ForEachIndexedEffect(EM2EffectIndexKey::Target, InMetadata.Target, nullptr, [&](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		if (StackedHandle.IsSet() || EffectHandle == IgnoreHandle || EffectMetadata.Effect != InMetadata.Effect)
+		{
+			return;
+		}
+		if (!EffectDefaults->bStackAcrossInstigators && !(EffectMetadata.Instigator == InMetadata.Instigator))
+		{
+			return;
+		}
+
+		StackedHandle = EffectHandle;
+	});
+
+	if (!StackedHandle.IsSet())
+	{
+		return StackedHandle;
+	}
+
+	// Merging can change the instigator, so the effect is re-indexed. This can't happen while iterating the index.
+	const int32 RecordIndex = GetRecordIndex(StackedHandle);
+	FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+	UnindexEffect(StackedHandle, EffectMetadata);
+	if (EffectMetadata.Stack(InMetadata, EffectDefaults->StackingPolicy, EffectDefaults->MaxStacks) && InPayload)
+	{
+		Payload[RecordIndex] = *InPayload;
+	}
+	IndexEffect(StackedHandle, EffectMetadata);
+
+	return StackedHandle;
+}
+
+void UM2EffectInstance::IndexEffect(const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+{
+	if (EffectMetadata.bIndexed)
+	{
+		return;
+	}
+	
+	if (EffectMetadata.Target.IsSet())
+	{
+		EffectsByTarget.Add(EffectMetadata.Target, EffectHandle);
+	}
+	if (EffectMetadata.Instigator.IsSet())
+	{
+		EffectsByInstigator.Add(EffectMetadata.Instigator, EffectHandle);
+	}
+	if (EffectMetadata.InstanceDataHandle.IsSet())
+	{
+		EffectsByInstanceData.Add(EffectMetadata.InstanceDataHandle, EffectHandle);
+	}
+
+	EffectMetadata.bIndexed = true;
+}
+
+void UM2EffectInstance::RebuildIndices()
+{
+	EffectsByTarget.Empty();
+	EffectsByInstigator.Empty();
+	EffectsByInstanceData.Empty();
+	
+	for (int32 RecordIndex = 0; RecordIndex < RecordHandles.Num(); ++RecordIndex)
+	{
+		Metadata[RecordIndex].bIndexed = false;
+		IndexEffect(RecordHandles[RecordIndex], Metadata[RecordIndex]);
+	}
+}
+
+void UM2EffectInstance::GetEffectsOnTarget(const FM2RecordHandle& Target, TArray<FM2RecordHandle>& OutEffects, TSubclassOf<UM2Effect> EffectClass)
+{
+	ForEachIndexedEffect(EM2EffectIndexKey::Target, Target, EffectClass, [&OutEffects](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		OutEffects.Add(EffectHandle);
+	});
+}
+
+void UM2EffectInstance::GetEffectsFromInstigator(const FM2RecordHandle& Instigator, TArray<FM2RecordHandle>& OutEffects, TSubclassOf<UM2Effect> EffectClass)
+{
+	ForEachIndexedEffect(EM2EffectIndexKey::Instigator, Instigator, EffectClass, [&OutEffects](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		OutEffects.Add(EffectHandle);
+	});
+}
+
+int32 UM2EffectInstance::CountEffectsOnTarget(const FM2RecordHandle& Target, TSubclassOf<UM2Effect> EffectClass)
+{
+	int32 Count = 0;
+	ForEachIndexedEffect(EM2EffectIndexKey::Target, Target, EffectClass, [&Count](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		Count++;
+	});
+	return Count;
+}
+
+int32 UM2EffectInstance::CountEffectsFromInstigator(const FM2RecordHandle& Instigator, TSubclassOf<UM2Effect> EffectClass)
+{
+	int32 Count = 0;
+	ForEachIndexedEffect(EM2EffectIndexKey::Instigator, Instigator, EffectClass, [&Count](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		Count++;
+	});
+	return Count;
+}
+
+int32 UM2EffectInstance::CancelEffectsOnTarget(const FM2RecordHandle& Target, TSubclassOf<UM2Effect> EffectClass)
+{
+	int32 Count = 0;
+	ForEachIndexedEffect(EM2EffectIndexKey::Target, Target, EffectClass, [&Count](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		EffectMetadata.CancelEffect();
+		Count++;
+	});
+	return Count;
+}
+
+int32 UM2EffectInstance::CancelEffectsFromInstigator(const FM2RecordHandle& Instigator, TSubclassOf<UM2Effect> EffectClass)
+{
+	int32 Count = 0;
+	ForEachIndexedEffect(EM2EffectIndexKey::Instigator, Instigator, EffectClass, [&Count](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+	{
+		EffectMetadata.CancelEffect();
+		Count++;
+	});
+	return Count;
+}
+
+void UM2EffectInstance::UnindexEffect(const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+{
+	if (!EffectMetadata.bIndexed)
+	{
+		return;
+	}
+
+	EffectsByTarget.RemoveSingle(EffectMetadata.Target, EffectHandle);
+	EffectsByInstigator.RemoveSingle(EffectMetadata.Instigator, EffectHandle);
+	EffectsByInstanceData.RemoveSingle(EffectMetadata.InstanceDataHandle, EffectHandle);
+	EffectMetadata.bIndexed = false;
+}
+
+void UM2EffectInstance::RemapRecord(const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle)
+{
+	if (!OldHandle.IsSet() || !IsReferenced(OldHandle))
+	{
+		return;
+	}
+
+	// Re-indexing changes the indices, so find every affected effect first.
+	TArray<FM2RecordHandle> EffectHandles;
+	EffectsByTarget.MultiFind(OldHandle, EffectHandles);
+	EffectsByInstigator.MultiFind(OldHandle, EffectHandles);
+	EffectsByInstanceData.MultiFind(OldHandle, EffectHandles);
+
+	for (const FM2RecordHandle& EffectHandle : EffectHandles)
+	{
+		const int32 RecordIndex = GetRecordIndex(EffectHandle);
+		if (RecordIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		// An effect that refers to the record in more than one role was already remapped.
+		FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+		if (!(EffectMetadata.Target == OldHandle) && !(EffectMetadata.Instigator == OldHandle) && !(EffectMetadata.InstanceDataHandle == OldHandle))
+		{
+			continue;
+		}
+		
+		UnindexEffect(EffectHandle, EffectMetadata);
+		for (FM2RecordHandle* Handle : {&EffectMetadata.Target, &EffectMetadata.Instigator, &EffectMetadata.InstanceDataHandle})
+		{
+			if (*Handle == OldHandle)
+			{
+				*Handle = NewHandle;
+			}
+		}
+		IndexEffect(EffectHandle, EffectMetadata);
+	}
+}
+
+void UM2EffectInstance::PreRemoveRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex)
+{
+	UnindexEffect(RecordHandle, Metadata[RecordIndex]);
+}
+
+void UM2EffectInstance::PostLoadRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex)
+{
+	// Unloading took the effect out of the indices (see PreRemoveRecord), so put it back.
+	Metadata[RecordIndex].bIndexed = false;
+	IndexEffect(RecordHandle, Metadata[RecordIndex]);
+}
+
+void UM2EffectInstance::PostMoveRecord(UM2RecordSet& Source, const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle, int32 RecordIndex)
+{
+	// The metadata came over from Source with its keys intact, which is all Source needs to drop its index entries.
+	FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+	CastChecked<UM2EffectInstance>(&Source)->UnindexEffect(OldHandle, EffectMetadata);
+	IndexEffect(NewHandle, EffectMetadata);
+}
+
+void UM2EffectInstance::ForEachIndexedEffect(
+	EM2EffectIndexKey IndexKey,
+	const FM2RecordHandle& Key,
+	TSubclassOf<UM2Effect> EffectClass,
+	TFunctionRef<void(const FM2RecordHandle&, FM2EffectMetadata&)> Callback
+)
+{
+	if (!Key.IsSet())
+	{
+		return;
+	}
+	
+	TMultiMap<FM2RecordHandle, FM2RecordHandle>& Index = GetIndex(IndexKey);
+	
+	for (auto Iterator = Index.CreateConstKeyIterator(Key); Iterator; ++Iterator)
+	{
+		const FM2RecordHandle& EffectHandle = Iterator.Value();
+		
+		int32 RecordIndex = GetRecordIndex(EffectHandle);
+		if (RecordIndex == INDEX_NONE)
+		{
+			continue;
+		}
+
+		FM2EffectMetadata& EffectMetadata = Metadata[RecordIndex];
+		
+		// Metadata that was overwritten wholesale (ie: through GetField) can leave stale entries, so double check the key.
+		if (!(GetIndexedKey(IndexKey, EffectMetadata) == Key) || !EffectMetadata.IsActive())
+		{
+			continue;
+		}
+		if (EffectClass && (!EffectMetadata.Effect || !EffectMetadata.Effect->IsChildOf(EffectClass)))
+		{
+			continue;
+		}
+
+		Callback(EffectHandle, EffectMetadata);
+	}
+}
+
+TMultiMap<FM2RecordHandle, FM2RecordHandle>& UM2EffectInstance::GetIndex(EM2EffectIndexKey IndexKey)
+{
+	switch (IndexKey)
+	{
+	case EM2EffectIndexKey::Instigator:
+		return EffectsByInstigator;
+	case EM2EffectIndexKey::InstanceData:
+		return EffectsByInstanceData;
+	default:
+		return EffectsByTarget;
+	}
+}
+
+const FM2RecordHandle& UM2EffectInstance::GetIndexedKey(EM2EffectIndexKey IndexKey, const FM2EffectMetadata& EffectMetadata)
+{
+	switch (IndexKey)
+	{
+	case EM2EffectIndexKey::Instigator:
+		return EffectMetadata.Instigator;
+	case EM2EffectIndexKey::InstanceData:
+		return EffectMetadata.InstanceDataHandle;
+	default:
+		return EffectMetadata.Target;
+	}
+}
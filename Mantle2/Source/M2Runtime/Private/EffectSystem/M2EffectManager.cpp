@@ -30,13 +30,22 @@
 // ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "EffectSystem/M2EffectManager.h"
+#include "EffectSystem/M2Attribute.h"
 #include "EffectSystem/M2Effect.h"
 #include "EffectSystem/M2EffectInstance.h"
 #include "Logging/M2LoggingDefs.h"
 #include "Logging/M2LoggingMacros.h"
+#include "Misc/ScopeExit.h"
 
 void UM2EffectManager::Initialize(UM2Registry* Registry)
 {
+	CachedEffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+	CachedModifierBuffer = Registry->GetShared<UM2AttributeModifierBuffer>();
+	Registry->OnRecordRemoved().RemoveAll(this);
+	Registry->OnRecordRemoved().AddUObject(this, &ThisClass::HandleRecordRemoved);
+	Registry->OnRecordMoved().RemoveAll(this);
+	Registry->OnRecordMoved().AddUObject(this, &ThisClass::HandleRecordMoved);
+	
 	for (TObjectIterator<UClass> ClassIterator; ClassIterator; ++ClassIterator)
 	{
 		UClass* TargetClass = *ClassIterator;
@@ -67,8 +76,27 @@ void UM2EffectManager::Initialize(UM2Registry* Registry)
 	}
 }
 
+void UM2EffectManager::FastForward(FM2OperationContext& Ctx)
+{
+	if (!Ctx.Registry.IsValid())
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to fast-forward effects: Invalid Registry"));
+		return;
+	}
+	
+	ProcessEffects(Ctx, true);
+}
+
 void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 {
+	const bool bFastForward = FastForwardThresholdSec >= 0.0f && Ctx.DeltaTime >= FastForwardThresholdSec;
+	ProcessEffects(Ctx, bFastForward);
+}
+
+void UM2EffectManager::ProcessEffects(FM2OperationContext& Ctx, bool bFastForward)
+{
+	SCOPE_CYCLE_COUNTER(STAT_M2_EffectManager);
+	
 	auto* EffectInstances = Ctx.Registry->GetRecordSet<UM2EffectInstance>();
 	if (!EffectInstances)
 	{
@@ -76,16 +104,21 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 		return;
 	}
 
+	PendingDeletions.Empty();
+
+	// Clean up effects whose target, instigator, or instance data went away before anything else ticks. This removes
+	// records, so it needs to happen before grabbing the field arrays below.
+	ProcessRemovedRecords(Ctx, *EffectInstances);
+
 	TArrayView<FM2RecordHandle> RecordHandles = EffectInstances->GetHandles();
 	TArrayView<FM2EffectMetadata> MetadataArray = EffectInstances->GetFieldArray<FM2EffectMetadata>();
+	TArrayView<FInstancedStruct> PayloadArray = EffectInstances->GetFieldArray<FInstancedStruct>();
 
-	if (RecordHandles.Num() != MetadataArray.Num())
+	if (RecordHandles.Num() != MetadataArray.Num() || RecordHandles.Num() != PayloadArray.Num())
 	{
 		M2_LOG(LogM2, Error, TEXT("Unable to perform operation: mismatch between record count and field count."))
 		return;
 	}
-
-	PendingDeletions.Empty();
 	
 	for (int32 RecordIndex = 0; RecordIndex < RecordHandles.Num(); ++RecordIndex)
 	{
@@ -96,18 +129,54 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 
 		if (!TargetEffect)
 		{
-			// TODO(): increment stat counter.
+			M2_LOG(LogM2, Warning, TEXT("Unable to find a shared object for effect class %s. Deleting effect."), *GetNameSafe(EffectMetadata.Effect));
 			EffectMetadata.State = EM2EffectState::Delete;
 			PendingDeletions.Add(RecordHandle);
 			continue;
 		}
+
+#if STATS
+		const FM2EffectClassStats& ClassStats = TargetEffect->GetStats();
+		FScopeCycleCounter ClassCycleCounter(ClassStats.TickStatId);
+		
+		if (EffectMetadata.IsActive())
+		{
+			INC_DWORD_STAT(STAT_M2_ActiveEffects);
+			INC_DWORD_STAT_FNAME_BY(ClassStats.ActiveCountStatId.GetName(), 1);
+		}
+		
+		const EM2EffectState PreviousState = EffectMetadata.State;
+		ON_SCOPE_EXIT
+		{
+			if (EffectMetadata.State != PreviousState)
+			{
+				INC_DWORD_STAT(STAT_M2_EffectStateTransitions);
+			}
+		};
+#endif
 		
 		FM2EffectContext EffectContext;
 		EffectContext.World = Ctx.World.Get();
 		EffectContext.Registry = Ctx.Registry.Get();
+		EffectContext.Modifiers = CachedModifierBuffer.Get();
+		EffectContext.Payload = &PayloadArray[RecordIndex];
 
 		if (EffectMetadata.State == EM2EffectState::Scheduled)
 		{
+			if (!EffectMetadata.bIndexed)
+			{
+				// Effects added directly through AddRecord instead of UM2EffectInstance::AddEffect haven't been stacked
+				// or indexed yet. If this one merges into an existing effect, it can be dropped without any callbacks.
+				if (EffectInstances->StackEffect(EffectMetadata, RecordHandle, &PayloadArray[RecordIndex]).IsSet())
+				{
+					EffectMetadata.State = EM2EffectState::Delete;
+					PendingDeletions.Add(RecordHandle);
+					continue;
+				}
+				
+				EffectInstances->IndexEffect(RecordHandle, EffectMetadata);
+			}
+			
 			if (!EffectMetadata.HasRemainingTriggers() || !EffectMetadata.HasRemainingDuration())
 			{
 				EffectMetadata.State = EM2EffectState::Finished;
@@ -115,6 +184,7 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 			}
 
 			// No need for any pre-tick processing, since this is the first tick.
+			INC_DWORD_STAT(STAT_M2_EffectTriggers);
 			EM2EffectTriggerResponse Response = TargetEffect->TickEffect(EffectContext, EffectMetadata);
 			if (Response == EM2EffectTriggerResponse::Continue)
 			{
@@ -135,6 +205,12 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 			EffectContext.DeltaTime = Ctx.DeltaTime;
 			EffectMetadata.TotalElapsedTime += EffectContext.DeltaTime;
 			EffectMetadata.TriggerElapsedTime += EffectContext.DeltaTime;
+
+			if (bFastForward)
+			{
+				FastForwardEffect(*TargetEffect, EffectContext, EffectMetadata);
+				continue;
+			}
 			
 			if (!EffectMetadata.HasRemainingTriggers() || !EffectMetadata.HasRemainingDuration())
 			{
@@ -147,20 +223,7 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 			}
 
 			EffectMetadata.PreTick();
-			
-			EM2EffectTriggerResponse Response = TargetEffect->TickEffect(EffectContext, EffectMetadata);
-			if (Response == EM2EffectTriggerResponse::Continue)
-			{
-				EffectMetadata.PostTick();
-			}
-			else if (Response == EM2EffectTriggerResponse::Done)
-			{
-				EffectMetadata.State = EM2EffectState::Finished;
-			}
-			else
-			{
-				EffectMetadata.State = EM2EffectState::Cancel;
-			}
+			HandleTriggerResponse(TargetEffect->TickEffect(EffectContext, EffectMetadata), EffectMetadata, 1);
 		}
 		else if (EffectMetadata.State == EM2EffectState::Cancel)
 		{
@@ -185,9 +248,197 @@ void UM2EffectManager::PerformOperation(FM2OperationContext& Ctx)
 		}
 	}
 
+	INC_DWORD_STAT_BY(STAT_M2_EffectRecordsDeleted, PendingDeletions.Num());
 	for (FM2RecordHandle& EffectHandle : PendingDeletions)
 	{
 		Ctx.Registry->RemoveRecord(EffectHandle);
 	}
 	PendingDeletions.Empty();
 }
+
+void UM2EffectManager::FastForwardEffect(UM2Effect& Effect, FM2EffectContext& EffectContext, FM2EffectMetadata& EffectMetadata)
+{
+	// Computed up front from the accumulated time, so the cost doesn't depend on how large the step was.
+	const int32 DueTriggers = EffectMetadata.GetDueTriggers();
+	const float LastTriggerTime = EffectMetadata.TotalElapsedTime - EffectMetadata.TriggerElapsedTime;
+	EffectMetadata.PreTickFastForward(DueTriggers);
+
+	int32 NumTriggersFired = 0;
+	if (DueTriggers > 0)
+	{
+		if (Effect.SupportsBatchedTriggers())
+		{
+			EffectContext.TriggerCount = DueTriggers;
+			HandleTriggerResponse(Effect.TickEffect(EffectContext, EffectMetadata), EffectMetadata, DueTriggers);
+			EffectContext.TriggerCount = 1;
+			NumTriggersFired = DueTriggers;
+		}
+		else
+		{
+			for (; NumTriggersFired < DueTriggers && EffectMetadata.State == EM2EffectState::Tick; ++NumTriggersFired)
+			{
+				HandleTriggerResponse(Effect.TickEffect(EffectContext, EffectMetadata), EffectMetadata, 1);
+			}
+		}
+	}
+
+	// Either the effect asked to stop, or it used up its last trigger.
+	const bool bEndedOnTrigger = EffectMetadata.State != EM2EffectState::Tick;
+
+	if (EffectMetadata.State == EM2EffectState::Tick && (!EffectMetadata.HasRemainingTriggers() || !EffectMetadata.HasRemainingDuration()))
+	{
+		EffectMetadata.State = EM2EffectState::Finished;
+	}
+
+	if (EffectMetadata.State != EM2EffectState::Tick)
+	{
+		// The effect ended partway through the step. Only consume the time up to the point where it ended, so that
+		// TotalElapsedTime reports when it actually finished.
+		float FinishTime = EffectMetadata.TotalElapsedTime;
+		const float FinalTriggerTime = LastTriggerTime + NumTriggersFired * EffectMetadata.TriggerRateSec;
+		if (bEndedOnTrigger && NumTriggersFired > 0 && EffectMetadata.TriggerRateSec > 0.0f)
+		{
+			FinishTime = FinalTriggerTime;
+		}
+		if (EffectMetadata.MaxDuration != FM2EffectMetadata::kUnlimitedDuration)
+		{
+			FinishTime = FMath::Min(FinishTime, EffectMetadata.MaxDuration);
+		}
+
+		EffectMetadata.TotalElapsedTime = FMath::Min(EffectMetadata.TotalElapsedTime, FinishTime);
+		EffectMetadata.TriggerElapsedTime = FMath::Max(EffectMetadata.TotalElapsedTime - FinalTriggerTime, 0.0f);
+	}
+}
+
+void UM2EffectManager::HandleTriggerResponse(EM2EffectTriggerResponse Response, FM2EffectMetadata& EffectMetadata, int32 NumTriggers)
+{
+	INC_DWORD_STAT_BY(STAT_M2_EffectTriggers, NumTriggers);
+	
+	if (Response == EM2EffectTriggerResponse::Continue)
+	{
+		EffectMetadata.PostTick(NumTriggers);
+	}
+	else if (Response == EM2EffectTriggerResponse::Done)
+	{
+		EffectMetadata.State = EM2EffectState::Finished;
+	}
+	else
+	{
+		EffectMetadata.State = EM2EffectState::Cancel;
+	}
+}
+
+void UM2EffectManager::ProcessRemovedRecords(FM2OperationContext& Ctx, UM2EffectInstance& EffectInstances)
+{
+	if (RemovedRecords.IsEmpty())
+	{
+		return;
+	}
+	
+	FM2EffectContext EffectContext;
+	EffectContext.World = Ctx.World.Get();
+	EffectContext.Registry = Ctx.Registry.Get();
+	EffectContext.Modifiers = CachedModifierBuffer.Get();
+
+	// Removing orphaned effects below may add to RemovedRecords, so work from a copy.
+	TArray<FM2RecordHandle> RemovedThisFrame = MoveTemp(RemovedRecords);
+	RemovedRecords.Reset();
+	
+	for (const FM2RecordHandle& RemovedRecord : RemovedThisFrame)
+	{
+		for (EM2EffectIndexKey IndexKey : {EM2EffectIndexKey::Target, EM2EffectIndexKey::Instigator, EM2EffectIndexKey::InstanceData})
+		{
+			// Callbacks can add effects, which changes the index and can move the metadata, so the dependent effects are
+			// gathered first and looked up again one at a time.
+			DependentEffects.Reset();
+			EffectInstances.ForEachIndexedEffect(IndexKey, RemovedRecord, nullptr, [&](const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata)
+			{
+				UM2Effect* TargetEffect = Ctx.Registry->GetShared<UM2Effect>(EffectMetadata.Effect);
+				if (!TargetEffect)
+				{
+					DependentEffects.Emplace(EffectHandle, EM2EffectDependencyPolicy::Delete);
+				}
+				else if (IndexKey == EM2EffectIndexKey::Target)
+				{
+					DependentEffects.Emplace(EffectHandle, TargetEffect->OnTargetRemoved);
+				}
+				else if (IndexKey == EM2EffectIndexKey::Instigator)
+				{
+					DependentEffects.Emplace(EffectHandle, TargetEffect->OnInstigatorRemoved);
+				}
+				else
+				{
+					DependentEffects.Emplace(EffectHandle, TargetEffect->OnInstanceDataRemoved);
+				}
+			});
+
+			for (const auto& [EffectHandle, Policy] : DependentEffects)
+			{
+				if (Policy == EM2EffectDependencyPolicy::Keep)
+				{
+					continue;
+				}
+
+				// An earlier callback may have removed or finished the effect.
+				FM2EffectMetadata* EffectMetadata = EffectInstances.GetField<FM2EffectMetadata>(EffectHandle);
+				if (!EffectMetadata || !EffectMetadata->IsActive())
+				{
+					continue;
+				}
+				
+				UM2Effect* TargetEffect = Ctx.Registry->GetShared<UM2Effect>(EffectMetadata->Effect);
+				if (!TargetEffect)
+				{
+					EffectMetadata->State = EM2EffectState::Delete;
+					PendingDeletions.Add(EffectHandle);
+					continue;
+				}
+
+				if (Policy == EM2EffectDependencyPolicy::Cancel)
+				{
+					EffectContext.Payload = EffectInstances.GetPayload(EffectHandle);
+					TargetEffect->OnCancelEffect(EffectContext, *EffectMetadata);
+					
+					EffectMetadata = EffectInstances.GetField<FM2EffectMetadata>(EffectHandle);
+					if (!EffectMetadata)
+					{
+						continue;
+					}
+				}
+
+				// Once the state is no longer active the effect won't be visited again, even if it refers to more than
+				// one of the removed records.
+				EffectMetadata->State = EM2EffectState::Delete;
+				EffectContext.Payload = EffectInstances.GetPayload(EffectHandle);
+				TargetEffect->OnDeleteEffect(EffectContext, *EffectMetadata);
+				PendingDeletions.Add(EffectHandle);
+				INC_DWORD_STAT(STAT_M2_EffectStateTransitions);
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_M2_EffectRecordsDeleted, PendingDeletions.Num());
+	for (FM2RecordHandle& EffectHandle : PendingDeletions)
+	{
+		Ctx.Registry->RemoveRecord(EffectHandle);
+	}
+	PendingDeletions.Empty();
+}
+
+void UM2EffectManager::HandleRecordRemoved(const FM2RecordHandle& RecordHandle)
+{
+	// Only queue records that are actually referenced so that mass removals don't build up a large list.
+	if (CachedEffectInstances.IsValid() && CachedEffectInstances->IsReferenced(RecordHandle))
+	{
+		RemovedRecords.Add(RecordHandle);
+	}
+}
+
+void UM2EffectManager::HandleRecordMoved(const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle)
+{
+	// Unlike removals, this can't wait for the next run: queries by the new handle need to find the effects right away.
+	if (CachedEffectInstances.IsValid())
+	{
+		CachedEffectInstances->RemapRecord(OldHandle, NewHandle);
+	}
+}
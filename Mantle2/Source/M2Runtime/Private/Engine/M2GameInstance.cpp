@@ -31,6 +31,7 @@
 
 #include "Engine/M2GameInstance.h"
 
+#include "EffectSystem/M2AttributeAggregator.h"
 #include "EffectSystem/M2EffectManager.h"
 #include "Foundation/M2Engine.h"
 #include "Logging/M2LoggingDefs.h"
@@ -115,6 +116,12 @@ void UM2GameInstance::ConfigureM2Engine(UM2Engine& Engine)
 		Engine.NewOperation<UM2EffectManager>(),
 	});
 
+	// Attribute modifiers emitted by effects are applied after all effects have ticked.
+	PrePhysicsPhase.OperationGroups.AddDefaulted();
+	PrePhysicsPhase.OperationGroups.Last().Operations.Append({
+		Engine.NewOperation<UM2AttributeAggregator>(),
+	});
+
 	Engine.ConfigureEngineLoop(TG_PrePhysics, PrePhysicsPhase);
 }
 
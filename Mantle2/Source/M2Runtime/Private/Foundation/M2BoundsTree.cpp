@@ -0,0 +1,305 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2BoundsTree.h"
+
+#include "Algo/Sort.h"
+#include "Async/ParallelFor.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+UM2BoundsTree* UM2BoundsTree::CreateInternal(UM2Registry& Registry, UScriptStruct* BoundsField, const TArray<UScriptStruct*>& Exclude, TFunction<void(UM2RecordSet&, TArray<FBox>&)>&& InGetBounds)
+{
+	if (Registry.BoundsTrees.Contains(BoundsField))
+	{
+		M2_LOG(LogM2, Warning, TEXT("Bounds tree for %s already exists."), *GetNameSafe(BoundsField));
+		return Registry.BoundsTrees.FindChecked(BoundsField);
+	}
+
+	UM2BoundsTree* BoundsTree = NewObject<UM2BoundsTree>(&Registry);
+	BoundsTree->GetBounds = MoveTemp(InGetBounds);
+
+	TArray<UScriptStruct*> Match = {BoundsField};
+	TArray<UScriptStruct*> ExcludeCopy = Exclude;
+	for (UM2RecordSet* RecordSet : Registry.GetAll(Match, ExcludeCopy))
+	{
+		BoundsTree->CoveredSets.Add(RecordSet);
+	}
+
+	Registry.BoundsTrees.Add(BoundsField, BoundsTree);
+	BoundsTree->Update();
+	return BoundsTree;
+}
+
+void UM2BoundsTree::Update()
+{
+	bLastUpdateRebuilt = !GatherItems() || Nodes.IsEmpty() || NumRefits >= MaxRefits;
+	
+	if (bLastUpdateRebuilt)
+	{
+		Rebuild();
+	}
+	else
+	{
+		Refit();
+	}
+}
+
+bool UM2BoundsTree::GatherItems()
+{
+	bool bUnchanged = true;
+	int32 ItemIndex = 0;
+	
+	for (TWeakObjectPtr<UM2RecordSet> WeakRecordSet : CoveredSets)
+	{
+		UM2RecordSet* RecordSet = WeakRecordSet.Get();
+		if (!RecordSet)
+		{
+			continue;
+		}
+
+		GetBounds(*RecordSet, BoundsScratch);
+		TArrayView<FM2RecordHandle> Handles = RecordSet->GetHandles();
+		if (BoundsScratch.Num() != Handles.Num())
+		{
+			M2_LOG(LogM2, Error, TEXT("Bounds tree got %d bounds for %d records in %s."), BoundsScratch.Num(), Handles.Num(), *RecordSet->GetName());
+			continue;
+		}
+
+		for (int32 RecordIndex = 0; RecordIndex < Handles.Num(); ++RecordIndex, ++ItemIndex)
+		{
+			if (ItemIndex >= ItemHandles.Num())
+			{
+				ItemHandles.Add(Handles[RecordIndex]);
+				ItemBounds.Add(BoundsScratch[RecordIndex]);
+				bUnchanged = false;
+				continue;
+			}
+
+			// The tree can only be refit if every record is where it was when the tree was built.
+			if (ItemHandles[ItemIndex] != Handles[RecordIndex])
+			{
+				ItemHandles[ItemIndex] = Handles[RecordIndex];
+				bUnchanged = false;
+			}
+			ItemBounds[ItemIndex] = BoundsScratch[RecordIndex];
+		}
+	}
+
+	if (ItemIndex != ItemHandles.Num())
+	{
+		ItemHandles.SetNum(ItemIndex);
+		ItemBounds.SetNum(ItemIndex);
+		bUnchanged = false;
+	}
+
+	return bUnchanged;
+}
+
+void UM2BoundsTree::Rebuild()
+{
+	NumRefits = 0;
+	Nodes.Reset();
+	ItemOrder.Reset();
+	if (ItemHandles.IsEmpty())
+	{
+		return;
+	}
+
+	for (int32 ItemIndex = 0; ItemIndex < ItemHandles.Num(); ++ItemIndex)
+	{
+		ItemOrder.Add(ItemIndex);
+	}
+
+	Nodes.AddDefaulted();
+	BuildNode(0, 0, ItemOrder.Num());
+}
+
+void UM2BoundsTree::BuildNode(int32 NodeIndex, int32 Begin, int32 End)
+{
+	FBox Bounds(ForceInit);
+	FBox Centers(ForceInit);
+	for (int32 OrderIndex = Begin; OrderIndex < End; ++OrderIndex)
+	{
+		const FBox& Item = ItemBounds[ItemOrder[OrderIndex]];
+		Bounds += Item;
+		Centers += Item.GetCenter();
+	}
+	Nodes[NodeIndex].Bounds = Bounds;
+
+	if (End - Begin <= kMaxLeafItems)
+	{
+		Nodes[NodeIndex].First = Begin;
+		Nodes[NodeIndex].NumItems = End - Begin;
+		return;
+	}
+
+	// Split at the median along the axis the records are most spread out on.
+	const FVector Spread = Centers.GetExtent();
+	const int32 Axis = Spread.X >= Spread.Y && Spread.X >= Spread.Z ? 0 : Spread.Y >= Spread.Z ? 1 : 2;
+	Algo::Sort(MakeArrayView(ItemOrder).Slice(Begin, End - Begin), [this, Axis](int32 A, int32 B)
+	{
+		return ItemBounds[A].GetCenter()[Axis] < ItemBounds[B].GetCenter()[Axis];
+	});
+
+	const int32 Middle = Begin + (End - Begin) / 2;
+	const int32 LeftChild = Nodes.AddDefaulted(2);
+	Nodes[NodeIndex].First = LeftChild;
+	Nodes[NodeIndex].NumItems = 0;
+	
+	BuildNode(LeftChild, Begin, Middle);
+	BuildNode(LeftChild + 1, Middle, End);
+}
+
+void UM2BoundsTree::Refit()
+{
+	NumRefits++;
+	
+	// Children come after their parents, so walking backwards refits every child before its parent.
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; --NodeIndex)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		if (Node.NumItems > 0)
+		{
+			Node.Bounds.Init();
+			for (int32 OrderIndex = Node.First; OrderIndex < Node.First + Node.NumItems; ++OrderIndex)
+			{
+				Node.Bounds += ItemBounds[ItemOrder[OrderIndex]];
+			}
+		}
+		else
+		{
+			Node.Bounds = Nodes[Node.First].Bounds + Nodes[Node.First + 1].Bounds;
+		}
+	}
+}
+
+bool UM2BoundsTree::IntersectBox(const FBox& Box, const FVector& Start, const FVector& Delta, float MaxTime, float& OutTime)
+{
+	double EntryTime = 0.0;
+	double ExitTime = MaxTime;
+	
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		if (FMath::IsNearlyZero(Delta[Axis]))
+		{
+			if (Start[Axis] < Box.Min[Axis] || Start[Axis] > Box.Max[Axis])
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const double InverseDelta = 1.0 / Delta[Axis];
+		double NearTime = (Box.Min[Axis] - Start[Axis]) * InverseDelta;
+		double FarTime = (Box.Max[Axis] - Start[Axis]) * InverseDelta;
+		if (NearTime > FarTime)
+		{
+			Swap(NearTime, FarTime);
+		}
+
+		EntryTime = FMath::Max(EntryTime, NearTime);
+		ExitTime = FMath::Min(ExitTime, FarTime);
+		if (EntryTime > ExitTime)
+		{
+			return false;
+		}
+	}
+
+	OutTime = EntryTime;
+	return true;
+}
+
+bool UM2BoundsTree::Raycast(const FM2BoundsRay& Ray, FM2BoundsHit& OutHit) const
+{
+	OutHit = FM2BoundsHit();
+	if (Nodes.IsEmpty())
+	{
+		return false;
+	}
+
+	// Sweeps are rays against boxes grown by the swept extent.
+	const FVector Delta = Ray.End - Ray.Start;
+	TArray<int32, TInlineAllocator<64>> Stack = {0};
+	
+	while (!Stack.IsEmpty())
+	{
+		const FNode& Node = Nodes[Stack.Pop(EAllowShrinking::No)];
+		float NodeTime = 0.0f;
+		if (!IntersectBox(Node.Bounds.ExpandBy(Ray.Extent), Ray.Start, Delta, OutHit.Time, NodeTime))
+		{
+			continue;
+		}
+
+		if (Node.NumItems == 0)
+		{
+			Stack.Add(Node.First);
+			Stack.Add(Node.First + 1);
+			continue;
+		}
+
+		for (int32 OrderIndex = Node.First; OrderIndex < Node.First + Node.NumItems; ++OrderIndex)
+		{
+			const int32 ItemIndex = ItemOrder[OrderIndex];
+			if (ItemHandles[ItemIndex] == Ray.Ignore)
+			{
+				continue;
+			}
+
+			float ItemTime = 0.0f;
+			if (IntersectBox(ItemBounds[ItemIndex].ExpandBy(Ray.Extent), Ray.Start, Delta, OutHit.Time, ItemTime) && (!OutHit.IsHit() || ItemTime < OutHit.Time))
+			{
+				OutHit.Handle = ItemHandles[ItemIndex];
+				OutHit.Time = ItemTime;
+			}
+		}
+	}
+
+	OutHit.Location = Ray.Start + Delta * OutHit.Time;
+	return OutHit.IsHit();
+}
+
+void UM2BoundsTree::RaycastBatch(TConstArrayView<FM2BoundsRay> Rays, TArray<FM2BoundsHit>& OutHits) const
+{
+	OutHits.SetNum(Rays.Num());
+	
+	ParallelFor(
+		TEXT("M2BoundsTree"),
+		Rays.Num(),
+		64,
+		[this, Rays, &OutHits](int32 RayIndex) { Raycast(Rays[RayIndex], OutHits[RayIndex]); }
+	);
+}
+
+void UM2BoundsTreeUpdateOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	Ctx.Registry->UpdateBoundsTrees();
+}
@@ -0,0 +1,245 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2Broadphase.h"
+
+#include "Foundation/M2Registry.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+TConstArrayView<FM2CollisionPair> UM2CollisionPairBuffer::GetPairs(FName Channel) const
+{
+	const TArray<FM2CollisionPair>* Pairs = PairsByChannel.Find(Channel);
+	return Pairs ? TConstArrayView<FM2CollisionPair>(*Pairs) : TConstArrayView<FM2CollisionPair>();
+}
+
+void UM2BroadphaseOperation::Initialize(UM2Registry* Registry)
+{
+	TArray<UScriptStruct*> Match;
+	TArray<UScriptStruct*> Exclude;
+	GetQuery(Match, Exclude);
+	FirstSets = Registry->GetAll(Match, Exclude);
+
+	Match.Reset();
+	Exclude.Reset();
+	GetSecondQuery(Match, Exclude);
+	bTwoQueries = !Match.IsEmpty();
+	SecondSets = bTwoQueries ? Registry->GetAll(Match, Exclude) : TArray<UM2RecordSet*>();
+
+	CachedBuffer = Registry->GetShared<UM2CollisionPairBuffer>();
+	if (CachedBuffer.IsValid())
+	{
+		CachedBuffer->RegisterChannel(Channel);
+	}
+}
+
+void UM2BroadphaseOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	// Runs that find too few records to pair up never get as far as choosing, and count as serial.
+	bLastRunParallel = false;
+	
+	// Broadphases in the same group run side by side, so the buffer and channel must already exist (see Initialize).
+	UM2CollisionPairBuffer* Buffer = CachedBuffer.Get();
+	if (!Buffer)
+	{
+		M2_LOG(LogM2, Error, TEXT("Broadphase %s ran without being initialized."), *GetName());
+		return;
+	}
+
+	TArray<FM2CollisionPair>& Pairs = Buffer->GetMutablePairs(Channel);
+	Pairs.Reset();
+
+	Gathered.Reset();
+	GatheredIndices.Reset();
+	for (UM2RecordSet* RecordSet : FirstSets)
+	{
+		GatherEntries(*RecordSet, EQuerySide::First);
+	}
+	for (UM2RecordSet* RecordSet : SecondSets)
+	{
+		GatherEntries(*RecordSet, EQuerySide::Second);
+	}
+	
+	SortEntries();
+	if (Entries.Num() < 2)
+	{
+		return;
+	}
+
+	bLastRunParallel = Execution == EM2ChunkExecution::Parallel || (Execution == EM2ChunkExecution::Auto && CostModel.ShouldRunParallel(Entries.Num()));
+	uint64 CpuCycles = 0;
+	
+	if (!bLastRunParallel)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 EntryIndex = 0; EntryIndex < Entries.Num(); ++EntryIndex)
+		{
+			FindPairs(EntryIndex, Pairs);
+		}
+		CpuCycles = FPlatformTime::Cycles64() - StartCycles;
+	}
+	else
+	{
+		// Every entry only looks forward along the sorted axis, so ranges of entries can be swept independently.
+		struct FWorkerPairs
+		{
+			TArray<FM2CollisionPair> Pairs;
+			uint64 Cycles = 0;
+		};
+
+		const int32 ChunkSize = CostModel.GetChunkSize();
+		const int32 NumChunks = FMath::DivideAndRoundUp(Entries.Num(), ChunkSize);
+		TArray<FWorkerPairs> WorkerPairs;
+		
+		ParallelForWithTaskContext(
+			TEXT("M2Broadphase"),
+			WorkerPairs,
+			NumChunks,
+			[this, ChunkSize](FWorkerPairs& Worker, int32 ChunkIndex)
+			{
+				const uint64 StartCycles = FPlatformTime::Cycles64();
+				const int32 EndIndex = FMath::Min((ChunkIndex + 1) * ChunkSize, Entries.Num());
+				for (int32 EntryIndex = ChunkIndex * ChunkSize; EntryIndex < EndIndex; ++EntryIndex)
+				{
+					FindPairs(EntryIndex, Worker.Pairs);
+				}
+				Worker.Cycles += FPlatformTime::Cycles64() - StartCycles;
+			},
+			NumChunks > 1 ? EParallelForFlags::Unbalanced : EParallelForFlags::ForceSingleThread
+		);
+
+		for (FWorkerPairs& Worker : WorkerPairs)
+		{
+			Pairs.Append(Worker.Pairs);
+			CpuCycles += Worker.Cycles;
+		}
+	}
+	
+	CostModel.RecordRun(Entries.Num(), FPlatformTime::ToMilliseconds64(CpuCycles) * 1000.0);
+}
+
+void UM2BroadphaseOperation::GatherEntries(UM2RecordSet& RecordSet, uint8 Sides)
+{
+	GetBounds(RecordSet, BoundsScratch);
+	
+	TArrayView<FM2RecordHandle> Handles = RecordSet.GetHandles();
+	if (BoundsScratch.Num() != Handles.Num())
+	{
+		M2_LOG(LogM2, Error, TEXT("%s: GetBounds returned %d bounds for %d records in %s."), *GetName(), BoundsScratch.Num(), Handles.Num(), *RecordSet.GetName());
+		return;
+	}
+
+	for (int32 RecordIndex = 0; RecordIndex < Handles.Num(); ++RecordIndex)
+	{
+		// A set can match both queries. It is gathered once, on both sides.
+		if (const int32* Existing = GatheredIndices.Find(Handles[RecordIndex]))
+		{
+			Gathered[*Existing].Sides |= Sides;
+			continue;
+		}
+
+		GatheredIndices.Add(Handles[RecordIndex], Gathered.Num());
+		Gathered.Add({BoundsScratch[RecordIndex], Handles[RecordIndex], Sides});
+	}
+}
+
+void UM2BroadphaseOperation::SortEntries()
+{
+	NumSortSwaps = 0;
+	
+	if (Sort == EM2BroadphaseSort::Full)
+	{
+		Swap(Entries, Gathered);
+		Entries.Sort([](const FEntry& A, const FEntry& B) { return A.Bounds.Min.X < B.Bounds.Min.X; });
+		return;
+	}
+
+	// Lay this run's records out in last run's order, then add any new ones at the end.
+	Swap(Entries, PreviousEntries);
+	Entries.Reset();
+	for (const FEntry& Previous : PreviousEntries)
+	{
+		if (const int32* GatheredIndex = GatheredIndices.Find(Previous.Handle))
+		{
+			Entries.Add(Gathered[*GatheredIndex]);
+			Gathered[*GatheredIndex].Sides = 0;
+		}
+	}
+	for (const FEntry& Entry : Gathered)
+	{
+		if (Entry.Sides != 0)
+		{
+			Entries.Add(Entry);
+		}
+	}
+
+	for (int32 EntryIndex = 1; EntryIndex < Entries.Num(); ++EntryIndex)
+	{
+		int32 InsertIndex = EntryIndex;
+		while (InsertIndex > 0 && Entries[InsertIndex - 1].Bounds.Min.X > Entries[InsertIndex].Bounds.Min.X)
+		{
+			Swap(Entries[InsertIndex - 1], Entries[InsertIndex]);
+			InsertIndex--;
+			NumSortSwaps++;
+		}
+	}
+}
+
+void UM2BroadphaseOperation::FindPairs(int32 EntryIndex, TArray<FM2CollisionPair>& OutPairs) const
+{
+	const FEntry& Entry = Entries[EntryIndex];
+	
+	for (int32 OtherIndex = EntryIndex + 1; OtherIndex < Entries.Num(); ++OtherIndex)
+	{
+		const FEntry& Other = Entries[OtherIndex];
+		if (Other.Bounds.Min.X > Entry.Bounds.Max.X)
+		{
+			break;
+		}
+		if (!Entry.Bounds.Intersect(Other.Bounds))
+		{
+			continue;
+		}
+
+		if (!bTwoQueries)
+		{
+			OutPairs.Add({Entry.Handle, Other.Handle});
+		}
+		else if ((Entry.Sides & EQuerySide::First) && (Other.Sides & EQuerySide::Second))
+		{
+			OutPairs.Add({Entry.Handle, Other.Handle});
+		}
+		else if ((Other.Sides & EQuerySide::First) && (Entry.Sides & EQuerySide::Second))
+		{
+			OutPairs.Add({Other.Handle, Entry.Handle});
+		}
+	}
+}
@@ -0,0 +1,93 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2ChunkScheduler.h"
+
+#include "Foundation/M2RecordSet.h"
+
+void FM2ChunkScheduler::BuildChunks(TConstArrayView<UM2RecordSet*> RecordSets)
+{
+	Chunks.Reset();
+	NumRecords = 0;
+
+	const int32 ClampedChunkSize = FMath::Max(ChunkSize, 1);
+	for (UM2RecordSet* RecordSet : RecordSets)
+	{
+		if (!RecordSet)
+		{
+			continue;
+		}
+		
+		const int32 SetNum = RecordSet->Num();
+		for (int32 StartIndex = 0; StartIndex < SetNum; StartIndex += ClampedChunkSize)
+		{
+			FM2RecordChunk& Chunk = Chunks.AddDefaulted_GetRef();
+			Chunk.RecordSet = RecordSet;
+			Chunk.StartIndex = StartIndex;
+			Chunk.EndIndex = FMath::Min(StartIndex + ClampedChunkSize, SetNum);
+		}
+		NumRecords += SetNum;
+	}
+}
+
+void FM2ChunkCostModel::RecordRun(int32 NumRecords, double CpuMicroseconds)
+{
+	if (NumRecords <= 0)
+	{
+		return;
+	}
+
+	// An exponential moving average, so set sizes swinging between levels are picked up within a few frames.
+	constexpr double Smoothing = 0.2;
+	const double Sample = CpuMicroseconds / NumRecords;
+	MicrosecondsPerRecord = MicrosecondsPerRecord <= 0.0 ? Sample : FMath::Lerp(MicrosecondsPerRecord, Sample, Smoothing);
+}
+
+bool FM2ChunkCostModel::ShouldRunParallel(int32 NumRecords) const
+{
+	if (!HasMeasurements() || NumRecords <= MinChunkSize)
+	{
+		return false;
+	}
+	
+	return NumRecords * MicrosecondsPerRecord >= MinParallelMicroseconds;
+}
+
+int32 FM2ChunkCostModel::GetChunkSize() const
+{
+	if (!HasMeasurements())
+	{
+		return MaxChunkSize;
+	}
+	
+	const double RecordsPerChunk = TargetChunkMicroseconds / MicrosecondsPerRecord;
+	return FMath::Clamp(static_cast<int32>(RecordsPerChunk), MinChunkSize, MaxChunkSize);
+}
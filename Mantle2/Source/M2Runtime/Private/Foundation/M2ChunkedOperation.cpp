@@ -0,0 +1,100 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2ChunkedOperation.h"
+
+#include "Foundation/M2Registry.h"
+
+void UM2ChunkedOperation::Initialize(UM2Registry* Registry)
+{
+	TArray<UScriptStruct*> Match;
+	TArray<UScriptStruct*> Exclude;
+	GetQuery(Match, Exclude);
+	
+	QuerySets = Registry->GetAll(Match, Exclude);
+}
+
+void UM2ChunkedOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	int32 NumRecords = 0;
+	for (UM2RecordSet* RecordSet : QuerySets)
+	{
+		NumRecords += RecordSet ? RecordSet->Num() : 0;
+	}
+	if (NumRecords == 0)
+	{
+		return;
+	}
+
+	bLastRunParallel = Execution == EM2ChunkExecution::Parallel || (Execution == EM2ChunkExecution::Auto && CostModel.ShouldRunParallel(NumRecords));
+	
+	// A serial run is a single chunk per set, so there's nothing to gain from cutting the sets up.
+	Scheduler.ChunkSize = !bLastRunParallel ? MAX_int32 : ChunkSizeOverride > 0 ? ChunkSizeOverride : CostModel.GetChunkSize();
+	Scheduler.BuildChunks(QuerySets);
+
+	const FM2OperationContext& ConstCtx = Ctx;
+	uint64 CpuCycles = 0;
+	
+	if (!bLastRunParallel)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (const FM2RecordChunk& Chunk : Scheduler.GetChunks())
+		{
+			ProcessChunk(ConstCtx, Chunk);
+		}
+		CpuCycles = FPlatformTime::Cycles64() - StartCycles;
+	}
+	else
+	{
+		// Each worker times its own chunks, so the measurement is CPU time rather than wall time.
+		struct FWorkerTiming
+		{
+			uint64 Cycles = 0;
+		};
+		
+		TArray<FWorkerTiming> WorkerTimings;
+		Scheduler.ForEachChunk(WorkerTimings, [this, &ConstCtx](FWorkerTiming& Timing, const FM2RecordChunk& Chunk)
+		{
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			ProcessChunk(ConstCtx, Chunk);
+			Timing.Cycles += FPlatformTime::Cycles64() - StartCycles;
+		});
+		
+		for (const FWorkerTiming& Timing : WorkerTimings)
+		{
+			CpuCycles += Timing.Cycles;
+		}
+	}
+	
+	CostModel.RecordRun(NumRecords, FPlatformTime::ToMilliseconds64(CpuCycles) * 1000.0);
+
+	PostProcessChunks(Ctx);
+}
@@ -0,0 +1,114 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2CoroutineOperation.h"
+
+FM2OperationTask::FM2OperationTask(FM2OperationTask&& Other) noexcept
+	: Handle(Other.Handle)
+{
+	Other.Handle = nullptr;
+}
+
+FM2OperationTask& FM2OperationTask::operator=(FM2OperationTask&& Other) noexcept
+{
+	if (this != &Other)
+	{
+		if (Handle)
+		{
+			Handle.destroy();
+		}
+		Handle = Other.Handle;
+		Other.Handle = nullptr;
+	}
+	return *this;
+}
+
+FM2OperationTask::~FM2OperationTask()
+{
+	if (Handle)
+	{
+		Handle.destroy();
+	}
+}
+
+bool FM2OperationTask::CanResume() const
+{
+	if (!Handle || Handle.done())
+	{
+		return false;
+	}
+
+	const FGraphEventRef& WaitEvent = Handle.promise().WaitEvent;
+	return !WaitEvent.IsValid() || WaitEvent->IsComplete();
+}
+
+void FM2OperationTask::Resume()
+{
+	if (!CanResume())
+	{
+		return;
+	}
+
+	promise_type& Promise = Handle.promise();
+	Promise.WaitEvent = nullptr;
+	Promise.ResumeStartCycles = FPlatformTime::Cycles64();
+	Handle.resume();
+}
+
+void UM2CoroutineOperation::BeginDestroy()
+{
+	// Destroying a suspended coroutine runs the destructors of everything in its frame, which may refer to this operation.
+	Task = FM2OperationTask();
+	
+	Super::BeginDestroy();
+}
+
+void UM2CoroutineOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	CurrentContext = Ctx;
+
+	if (!Task.IsValid() || Task.IsDone())
+	{
+		if (Task.IsDone())
+		{
+			bHasFinishedTask = true;
+			Task = FM2OperationTask();
+		}
+		if (bHasFinishedTask && !bRestartWhenFinished)
+		{
+			return;
+		}
+		
+		Task = RunTask();
+	}
+
+	Task.Resume();
+}
@@ -31,6 +31,7 @@
 
 #include "Foundation/M2Engine.h"
 
+#include "Foundation/M2KernelOperation.h"
 #include "Foundation/M2Operation.h"
 #include "Logging/M2LoggingDefs.h"
 #include "Logging/M2LoggingMacros.h"
@@ -42,6 +43,56 @@ FM2EngineLoop::FM2EngineLoop()
 	bTickEvenWhenPaused = false;
 }
 
+void FM2EngineLoop::ApplyOptions(const FM2EngineLoopOptions& NewOptions)
+{
+	const FString PhaseNameString = PhaseName.ToString();
+	Options.OperationGroups.Append(NewOptions.OperationGroups);
+
+	// Timestep settings apply to the whole loop. Only opt in to a fixed timestep, so that configuring more operation
+	// groups later with the default options doesn't switch the loop back to a variable timestep.
+	if (NewOptions.bUseFixedTimestep)
+	{
+		if (NewOptions.FixedTimestep <= 0.0f || NewOptions.MaxSubsteps <= 0)
+		{
+			M2_LOG(LogM2, Error, TEXT("Invalid fixed timestep settings for phase %s: FixedTimestep and MaxSubsteps must be greater than zero."), *PhaseNameString);
+			return;
+		}
+		
+		Options.bUseFixedTimestep = true;
+		Options.FixedTimestep = NewOptions.FixedTimestep;
+		Options.MaxSubsteps = NewOptions.MaxSubsteps;
+	}
+
+	// Same for the frame budget.
+	if (NewOptions.FrameBudgetMs >= 0.0f)
+	{
+		Options.FrameBudgetMs = NewOptions.FrameBudgetMs;
+		Options.MaxDeferredFrames = NewOptions.MaxDeferredFrames;
+	}
+
+	if (NewOptions.bRunOnAnyThread)
+	{
+		Options.bRunOnAnyThread = true;
+	}
+
+	// Once a loop runs off the game thread, everything added to it has to be thread safe, no matter which call added it.
+	if (Options.bRunOnAnyThread)
+	{
+		for (const FM2OperationGroup& OperationGroup : Options.OperationGroups)
+		{
+			for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+			{
+				if (Operation.IsValid() && !Operation->IsThreadSafe())
+				{
+					M2_LOG(LogM2, Error, TEXT("Operation %s is not thread safe. Phase %s will run on the game thread."), *Operation->GetClass()->GetName(), *PhaseNameString);
+					Options.bRunOnAnyThread = false;
+				}
+			}
+		}
+	}
+	bRunOnAnyThread = Options.bRunOnAnyThread;
+}
+
 void FM2EngineLoop::ExecuteTick(
 	float DeltaTime,
 	ELevelTick TickType,
@@ -54,8 +105,6 @@ void FM2EngineLoop::ExecuteTick(
 		return;
 	}
 
-	OperationContext.DeltaTime = DeltaTime;
-	
 	if (!OperationContext.World.IsValid())
 	{
 		M2_LOG(LogM2, Error, TEXT("Unable to tick operation groups: Invalid World"));
@@ -67,29 +116,259 @@ void FM2EngineLoop::ExecuteTick(
 		return;
 	}
 
+	if (Options.bRunOnAnyThread)
+	{
+		DispatchLoop(DeltaTime, MyCompletionGraphEvent);
+		return;
+	}
+
+	RunLoop(DeltaTime);
+}
+
+void FM2EngineLoop::FinishConfiguration(UObject& Outer, UM2Registry& Registry, TArray<TObjectPtr<UM2Operation>>& OwnedOperations)
+{
+	FuseKernelOperations(Outer, Registry, OwnedOperations);
+	StaggerOperations();
+}
+
+void FM2EngineLoop::StaggerOperations()
+{
+	int32 NumThrottled = 0;
+	
 	for (FM2OperationGroup& OperationGroup : Options.OperationGroups)
 	{
-		// In the future, we may support multithreading by running operations in the same OperationGroup concurrently.
-		// Something like:
-		// if (bRunMultithreaded)
-		// {
-		//   for(Operation : Group.Operations) {
-		//     Operation.RunConcurrent();
-		//   }
-		//   Wait();
-		// }
+		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+		{
+			if (!Operation.IsValid() || !Operation->IsThrottled())
+			{
+				continue;
+			}
+
+			if (Operation->PhaseOffset == UM2Operation::kAutoPhaseOffset)
+			{
+				// Frame intervals wrap around, so that every offset lands within the first interval.
+				Operation->PhaseOffset = Operation->TickIntervalFrames > 1 ? NumThrottled % Operation->TickIntervalFrames : NumThrottled;
+				M2_LOG(LogM2, Log, TEXT("Operation %s staggered by %d iterations."), *Operation->GetClass()->GetName(), Operation->PhaseOffset);
+			}
+			NumThrottled++;
+			
+			Operation->ResetTickInterval();
+		}
+	}
+}
+
+void FM2EngineLoop::FuseKernelOperations(UObject& Outer, UM2Registry& Registry, TArray<TObjectPtr<UM2Operation>>& OwnedOperations)
+{
+	for (FM2OperationGroup& OperationGroup : Options.OperationGroups)
+	{
+		TArray<TWeakObjectPtr<UM2Operation>> FusedOperations;
+		
+		for (int32 OperationIndex = 0; OperationIndex < OperationGroup.Operations.Num();)
+		{
+			UM2KernelOperation* FirstKernel = Cast<UM2KernelOperation>(OperationGroup.Operations[OperationIndex].Get());
+
+			// Find the run of kernels that can share a pass with the first one.
+			int32 EndIndex = OperationIndex + 1;
+			while (FirstKernel && EndIndex < OperationGroup.Operations.Num())
+			{
+				const UM2KernelOperation* NextKernel = Cast<UM2KernelOperation>(OperationGroup.Operations[EndIndex].Get());
+				if (!NextKernel || !FirstKernel->CanFuseWith(*NextKernel))
+				{
+					break;
+				}
+				EndIndex++;
+			}
+
+			if (EndIndex - OperationIndex < 2)
+			{
+				FusedOperations.Add(OperationGroup.Operations[OperationIndex]);
+				OperationIndex = EndIndex;
+				continue;
+			}
+
+			UM2FusedKernelOperation* FusedOperation = NewObject<UM2FusedKernelOperation>(&Outer);
+			for (int32 KernelIndex = OperationIndex; KernelIndex < EndIndex; ++KernelIndex)
+			{
+				FusedOperation->AddKernel(*CastChecked<UM2KernelOperation>(OperationGroup.Operations[KernelIndex].Get()));
+			}
+			FusedOperation->Initialize(&Registry);
+			FusedOperation->CreateStats();
+			OwnedOperations.Add(FusedOperation);
+			FusedOperations.Add(FusedOperation);
+			
+			M2_LOG(LogM2, Log, TEXT("Fused %d kernel operations, starting with %s."), EndIndex - OperationIndex, *FirstKernel->GetClass()->GetName());
+			OperationIndex = EndIndex;
+		}
+
+		OperationGroup.Operations = MoveTemp(FusedOperations);
+	}
+}
+
+int32 FM2EngineLoop::BeginFrame(float DeltaTime)
+{
+	FrameStartCycles = FPlatformTime::Cycles64();
+	
+	if (!Options.bUseFixedTimestep)
+	{
+		OperationContext.DeltaTime = DeltaTime;
+		OperationContext.InterpolationAlpha = 1.0f;
+		return 1;
+	}
+
+	if (Options.FixedTimestep <= 0.0f)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to tick operation groups: FixedTimestep must be greater than zero."));
+		return 0;
+	}
+
+	TimeAccumulator += DeltaTime;
+	OperationContext.DeltaTime = Options.FixedTimestep;
+
+	int32 NumSteps = 0;
+	while (TimeAccumulator >= Options.FixedTimestep && NumSteps < Options.MaxSubsteps)
+	{
+		TimeAccumulator -= Options.FixedTimestep;
+		NumSteps++;
+	}
+
+	if (TimeAccumulator >= Options.FixedTimestep)
+	{
+		M2_LOG(LogM2, Verbose, TEXT("Engine loop fell behind by %.3f seconds. Dropping the extra time."), TimeAccumulator);
+		TimeAccumulator = FMath::Fmod(TimeAccumulator, Options.FixedTimestep);
+	}
+
+	// This is the leftover time after all of this frame's steps, which is what presentation wants to blend with. It is
+	// worked out up front, so the steps below see it too, but it only means something to consumers after the steps.
+	OperationContext.InterpolationAlpha = TimeAccumulator / Options.FixedTimestep;
+	return NumSteps;
+}
+
+void FM2EngineLoop::RunLoop(float DeltaTime)
+{
+	const int32 NumSteps = BeginFrame(DeltaTime);
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		RunOperationGroups();
+	}
+}
+
+void FM2EngineLoop::DispatchLoop(float DeltaTime, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	const int32 NumSteps = BeginFrame(DeltaTime);
+	
+	FGraphEventArray Prerequisites;
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		for (FM2OperationGroup& OperationGroup : Options.OperationGroups)
+		{
+			FGraphEventArray GroupEvents;
+			
+			for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+			{
+				if (!Operation.IsValid())
+				{
+					M2_LOG(LogM2, Error, TEXT("Operation is invalid."));
+					continue;
+				}
+
+				// An operation only appears once per loop and groups wait on each other, so no two tasks ever touch the
+				// same operation at the same time.
+				UM2Operation* OperationPtr = Operation.Get();
+				GroupEvents.Add(FFunctionGraphTask::CreateAndDispatchWhenReady(
+					[this, OperationPtr]() { RunOperation(*OperationPtr); },
+					TStatId(),
+					&Prerequisites,
+					ENamedThreads::AnyHiPriThreadHiPriTask
+				));
+			}
+
+			if (!GroupEvents.IsEmpty())
+			{
+				Prerequisites = MoveTemp(GroupEvents);
+			}
+		}
+	}
+
+	for (const FGraphEventRef& Event : Prerequisites)
+	{
+		MyCompletionGraphEvent->DontCompleteUntil(Event);
+	}
+}
 
+void FM2EngineLoop::RunOperationGroups()
+{
+	for (FM2OperationGroup& OperationGroup : Options.OperationGroups)
+	{
+		// Loops that run off the game thread go through DispatchLoop instead, which runs each group's operations
+		// concurrently.
 		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
 		{
 			if (!Operation.IsValid())
 			{
 				M2_LOG(LogM2, Error, TEXT("Operation is invalid."));
+				continue;
 			}
-			Operation->Run(OperationContext);
+
+			RunOperation(*Operation);
 		}
 	}
 }
 
+void FM2EngineLoop::RunOperation(UM2Operation& Operation)
+{
+	// Throttled operations get the time that has passed since they last ran.
+	float OperationDeltaTime = OperationContext.DeltaTime;
+	if (Operation.IsThrottled() && !Operation.ConsumeTickInterval(OperationContext.DeltaTime, OperationDeltaTime))
+	{
+		return;
+	}
+
+	// Every operation gets its own copy of the context, since operations in the same group may run concurrently.
+	FM2OperationContext Ctx = OperationContext;
+	Ctx.DeltaTime = OperationDeltaTime;
+	
+	if (Options.FrameBudgetMs < 0.0f)
+	{
+		Operation.Run(Ctx);
+		return;
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	const double ElapsedMs = FPlatformTime::ToMilliseconds64(StartCycles - FrameStartCycles);
+	if (Operation.ShouldDefer(ElapsedMs, Options.FrameBudgetMs, Options.MaxDeferredFrames))
+	{
+		Operation.Defer(OperationDeltaTime);
+		return;
+	}
+
+	Ctx.DeltaTime += Operation.ConsumeDeferredTime();
+	Operation.Run(Ctx);
+	
+	Operation.RecordCost(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles));
+}
+
+FM2SimulationSyncTick::FM2SimulationSyncTick()
+{
+	bCanEverTick = true;
+	bStartWithTickEnabled = false;
+	bTickEvenWhenPaused = false;
+	bHighPriority = true;
+	TickGroup = ETickingGroup::TG_PrePhysics;
+}
+
+void FM2SimulationSyncTick::ExecuteTick(
+	float DeltaTime,
+	ELevelTick TickType,
+	ENamedThreads::Type CurrentThread,
+	const FGraphEventRef& MyCompletionGraphEvent
+)
+{
+	if (Engine.IsValid())
+	{
+		Engine->PublishSimulationResults();
+	}
+}
+
 UM2Engine::UM2Engine(const FObjectInitializer& ObjectInitializer)
 {
 	PrePhysicsLoop.TickGroup = ETickingGroup::TG_PrePhysics;
@@ -99,6 +378,11 @@ UM2Engine::UM2Engine(const FObjectInitializer& ObjectInitializer)
 	PostPhysicsLoop.TickGroup = ETickingGroup::TG_PostPhysics;
 	FrameEndLoop.TickGroup = ETickingGroup::TG_LastDemotable;
 
+	for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+	{
+		EngineLoop->PhaseName = UEnum::GetValueAsName(EngineLoop->TickGroup.GetValue());
+	}
+
 	Registry = CreateDefaultSubobject<UM2Registry>(TEXT("M2Registry"));
 }
 
@@ -121,6 +405,8 @@ void UM2Engine::Deinitialize()
 {
 	Super::Deinitialize();
 
+	SimulationThread.Reset();
+
 	ResetCounters();
 }
 
@@ -128,35 +414,264 @@ void UM2Engine::ConfigureEngineLoop(const ETickingGroup TickGroup, const FM2Engi
 {
 	M2_LOG(LogM2, Log, TEXT("Configuring engine loop for TickGroup: %s."), *UEnum::GetValueAsName(TickGroup).ToString());
 	
-	if (EngineState == EM2EngineState::Started)
+	if (EngineState != EM2EngineState::Initialize)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to configure engine loop: Engine has already been configured."));
+		return;
+	}
+
+	FM2EngineLoop* EngineLoop = GetEngineLoop(TickGroup);
+	if (!EngineLoop)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unknown TickGroup: %s. Use ConfigureEnginePhase to run operations elsewhere in the frame."), *UEnum::GetDisplayValueAsText(TickGroup).ToString());
+		return;
+	}
+
+	EngineLoop->ApplyOptions(Options);
+}
+
+void UM2Engine::ConfigureEnginePhase(const FName PhaseName, const FM2EnginePhaseOptions& PhaseOptions, const FM2EngineLoopOptions& Options)
+{
+	M2_LOG(LogM2, Log, TEXT("Configuring engine phase: %s."), *PhaseName.ToString());
+	
+	if (EngineState != EM2EngineState::Initialize)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to configure engine phase: Engine has already been configured."));
+		return;
+	}
+	if (PhaseName.IsNone())
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to configure engine phase: PhaseName must be set."));
+		return;
+	}
+
+	FM2EngineLoop* EngineLoop = GetEngineLoop(PhaseName);
+	if (!EngineLoop)
+	{
+		EngineLoop = CustomPhases.Add_GetRef(MakeUnique<FM2EngineLoop>()).Get();
+		EngineLoop->PhaseName = PhaseName;
+		EngineLoop->TickGroup = PhaseOptions.TickGroup;
+	}
+	else if (EngineLoop->TickGroup != PhaseOptions.TickGroup)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Phase %s is already configured to start in %s. Ignoring the new tick group."), *PhaseName.ToString(), *UEnum::GetValueAsName(EngineLoop->TickGroup.GetValue()).ToString());
+	}
+
+	for (const FName& RunAfter : PhaseOptions.RunAfter)
+	{
+		EngineLoop->RunAfterPhases.AddUnique(RunAfter);
+	}
+
+	for (const FName& RunBefore : PhaseOptions.RunBefore)
+	{
+		EngineLoop->RunBeforePhases.AddUnique(RunBefore);
+	}
+
+	EngineLoop->ApplyOptions(Options);
+}
+
+void UM2Engine::AddPhasePrerequisite(const FName PhaseName, UObject* TargetObject, FTickFunction& TickFunction)
+{
+	FM2EngineLoop* EngineLoop = GetEngineLoop(PhaseName);
+	if (!EngineLoop)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to add phase prerequisite: Unknown phase %s."), *PhaseName.ToString());
+		return;
+	}
+
+	EngineLoop->AddPrerequisite(TargetObject, TickFunction);
+}
+
+void UM2Engine::AddPhaseDependent(const FName PhaseName, FTickFunction& TickFunction)
+{
+	FM2EngineLoop* EngineLoop = GetEngineLoop(PhaseName);
+	if (!EngineLoop)
 	{
-		M2_LOG(LogM2, Warning, TEXT("Unable to configure engine loop: Engine is already started."));
+		M2_LOG(LogM2, Error, TEXT("Unable to add phase dependent: Unknown phase %s."), *PhaseName.ToString());
 		return;
 	}
 
+	TickFunction.AddPrerequisite(this, *EngineLoop);
+}
+
+FM2EngineLoop* UM2Engine::GetEngineLoop(const ETickingGroup TickGroup)
+{
 	switch (TickGroup)
 	{
 	case TG_PrePhysics:
-		PrePhysicsLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &PrePhysicsLoop;
 	case TG_StartPhysics:
-		StartPhysicsLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &StartPhysicsLoop;
 	case TG_DuringPhysics:
-		DuringPhysicsLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &DuringPhysicsLoop;
 	case TG_EndPhysics:
-		EndPhysicsLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &EndPhysicsLoop;
 	case TG_PostPhysics:
-		PostPhysicsLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &PostPhysicsLoop;
 	case TG_LastDemotable:
-		FrameEndLoop.Options.OperationGroups.Append(Options.OperationGroups);
-		break;
+		return &FrameEndLoop;
 	default:
-		M2_LOG(LogM2, Error, TEXT("Unknown TickGroup: %s"), *UEnum::GetDisplayValueAsText(TickGroup).ToString());
-		break;
+		return nullptr;
+	}
+}
+
+FM2EngineLoop* UM2Engine::GetEngineLoop(const FName PhaseName)
+{
+	for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+	{
+		if (EngineLoop->PhaseName == PhaseName)
+		{
+			return EngineLoop;
+		}
+	}
+	return nullptr;
+}
+
+TArray<FM2EngineLoop*, TInlineAllocator<6>> UM2Engine::GetEngineLoops()
+{
+	TArray<FM2EngineLoop*, TInlineAllocator<6>> EngineLoops = {&PrePhysicsLoop, &StartPhysicsLoop, &DuringPhysicsLoop, &EndPhysicsLoop, &PostPhysicsLoop, &FrameEndLoop};
+	for (const TUniquePtr<FM2EngineLoop>& CustomPhase : CustomPhases)
+	{
+		EngineLoops.Add(CustomPhase.Get());
+	}
+	return EngineLoops;
+}
+
+void UM2Engine::ResolvePhases()
+{
+	TArray<FM2EngineLoop*, TInlineAllocator<6>> EngineLoops = GetEngineLoops();
+	
+	// RunBefore is just RunAfter from the other phase's point of view.
+	for (FM2EngineLoop* EngineLoop : EngineLoops)
+	{
+		for (const FName& RunBefore : EngineLoop->RunBeforePhases)
+		{
+			FM2EngineLoop* OtherLoop = GetEngineLoop(RunBefore);
+			if (!OtherLoop)
+			{
+				M2_LOG(LogM2, Error, TEXT("Phase %s runs before unknown phase %s."), *EngineLoop->PhaseName.ToString(), *RunBefore.ToString());
+				continue;
+			}
+			
+			// Self edges are reported as cycles below.
+			OtherLoop->RunAfterPhases.AddUnique(EngineLoop->PhaseName);
+		}
+		EngineLoop->RunBeforePhases.Reset();
+	}
+
+	TMap<FM2EngineLoop*, TArray<FM2EngineLoop*>> Prerequisites;
+	for (FM2EngineLoop* EngineLoop : EngineLoops)
+	{
+		TArray<FM2EngineLoop*>& LoopPrerequisites = Prerequisites.Add(EngineLoop);
+		for (const FName& RunAfter : EngineLoop->RunAfterPhases)
+		{
+			FM2EngineLoop* OtherLoop = GetEngineLoop(RunAfter);
+			if (!OtherLoop)
+			{
+				M2_LOG(LogM2, Error, TEXT("Phase %s runs after unknown phase %s."), *EngineLoop->PhaseName.ToString(), *RunAfter.ToString());
+				continue;
+			}
+			if (OtherLoop == EngineLoop)
+			{
+				// The shortest possible cycle. A tick function waiting on itself would never run, so drop the edge.
+				M2_LOG(LogM2, Error, TEXT("Engine phases have circular prerequisites. Phase %s runs after itself."), *EngineLoop->PhaseName.ToString());
+				continue;
+			}
+			
+			EngineLoop->AddPrerequisite(this, *OtherLoop);
+			LoopPrerequisites.Add(OtherLoop);
+		}
+	}
+
+	// The tick task manager takes care of ordering while ticking, but Step runs the loops itself, so it needs the same
+	// order up front: the earliest tick group first, among the loops whose prerequisites have all run.
+	OrderedEngineLoops.Reset();
+	TArray<FM2EngineLoop*> RemainingLoops(EngineLoops);
+	while (!RemainingLoops.IsEmpty())
+	{
+		int32 NextIndex = INDEX_NONE;
+		for (int32 LoopIndex = 0; LoopIndex < RemainingLoops.Num(); ++LoopIndex)
+		{
+			FM2EngineLoop* EngineLoop = RemainingLoops[LoopIndex];
+			const bool bIsReady = !Prerequisites[EngineLoop].ContainsByPredicate([&](FM2EngineLoop* Prerequisite) { return RemainingLoops.Contains(Prerequisite); });
+			if (bIsReady && (NextIndex == INDEX_NONE || EngineLoop->TickGroup < RemainingLoops[NextIndex]->TickGroup))
+			{
+				NextIndex = LoopIndex;
+			}
+		}
+
+		if (NextIndex == INDEX_NONE)
+		{
+			M2_LOG(LogM2, Error, TEXT("Engine phases have circular prerequisites. Phase %s and the phases after it will run in tick group order."), *RemainingLoops[0]->PhaseName.ToString());
+			RemainingLoops.StableSort([](const FM2EngineLoop& A, const FM2EngineLoop& B) { return A.TickGroup < B.TickGroup; });
+			OrderedEngineLoops.Append(RemainingLoops);
+			break;
+		}
+		
+		OrderedEngineLoops.Add(RemainingLoops[NextIndex]);
+		RemainingLoops.RemoveAt(NextIndex);
+	}
+}
+
+void UM2Engine::ConfigureSimulation(const FM2SimulationOptions& Options)
+{
+	if (EngineState != EM2EngineState::Initialize)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to configure simulation: Engine has already been configured."));
+		return;
+	}
+	if (Options.TickRateHz <= 0.0f)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to configure simulation: TickRateHz must be greater than zero."));
+		return;
+	}
+
+	for (const FM2OperationGroup& OperationGroup : Options.OperationGroups)
+	{
+		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+		{
+			if (Operation.IsValid() && !Operation->IsThreadSafe())
+			{
+				M2_LOG(LogM2, Error, TEXT("Unable to configure simulation: Operation %s is not thread safe."), *Operation->GetClass()->GetName());
+				return;
+			}
+		}
+	}
+
+	SimulationLoop.Options.OperationGroups.Append(Options.OperationGroups);
+	if (!SimulationThread)
+	{
+		SimulationThread = MakeUnique<FM2SimulationThread>(SimulationLoop, *Registry, Options.TickRateHz);
+	}
+}
+
+bool UM2Engine::CanPublishFields()
+{
+	if (EngineState != EM2EngineState::Initialize || !SimulationThread)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to publish field: ConfigureSimulation must be called first, during configuration."));
+		return false;
+	}
+	return true;
+}
+
+void UM2Engine::EnqueueSimulationCommand(TFunction<void(UM2Registry&)>&& Command)
+{
+	if (!SimulationThread)
+	{
+		// Without a simulation thread the game thread owns the registry, so there's nothing to wait for.
+		Command(*Registry);
+		return;
+	}
+	
+	SimulationThread->EnqueueCommand(MoveTemp(Command));
+}
+
+void UM2Engine::PublishSimulationResults()
+{
+	if (SimulationThread)
+	{
+		SimulationThread->Publish();
 	}
 }
 
@@ -165,8 +680,16 @@ void UM2Engine::FinishConfiguration()
 	for (TObjectPtr<UM2Operation> Operation : Operations)
 	{
 		Operation->Initialize(Registry);
+		Operation->CreateStats();
 		M2_LOG(LogM2, Log, TEXT("Operation %s initialized."), *Operation->GetClass()->GetName());
 	}
+
+	for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+	{
+		EngineLoop->FinishConfiguration(*this, *Registry, Operations);
+	}
+	SimulationLoop.FinishConfiguration(*this, *Registry, Operations);
+	ResolvePhases();
 	
 	EngineState = EM2EngineState::Stopped;	
 }
@@ -180,12 +703,31 @@ void UM2Engine::Start(UWorld& World)
 	}
 
 	M2_LOG_OBJECT(this, LogM2, Log, TEXT("Starting M2Engine."));
-	ActivateEngineLoop(PrePhysicsLoop, World);
-	ActivateEngineLoop(StartPhysicsLoop, World);
-	ActivateEngineLoop(DuringPhysicsLoop, World);
-	ActivateEngineLoop(EndPhysicsLoop, World);
-	ActivateEngineLoop(PostPhysicsLoop, World);
-	ActivateEngineLoop(FrameEndLoop, World);
+	for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+	{
+		if (SimulationThread && !CanRunAlongsideSimulation(*EngineLoop))
+		{
+			continue;
+		}
+		ActivateEngineLoop(*EngineLoop, World);
+	}
+
+	if (SimulationThread)
+	{
+		SimulationSyncTick.Engine = this;
+		SimulationSyncTick.RegisterTickFunction(World.PersistentLevel);
+		SimulationSyncTick.SetTickFunctionEnable(true);
+		for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+		{
+			EngineLoop->AddPrerequisite(this, SimulationSyncTick);
+		}
+		
+		SimulationThread->StartThread();
+	}
+
+	StartedWorld = &World;
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &ThisClass::HandleLevelAddedToWorld);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &ThisClass::HandleLevelRemovedFromWorld);
 
 	EngineState = EM2EngineState::Started;
 	M2_LOG_OBJECT(this, LogM2, Log, TEXT("M2Engine started."));
@@ -194,17 +736,100 @@ void UM2Engine::Start(UWorld& World)
 void UM2Engine::Stop()
 {
 	M2_LOG_OBJECT(this, LogM2, Log, TEXT("Stopping M2Engine."));
-	DeactivateEngineLoop(PrePhysicsLoop);
-	DeactivateEngineLoop(StartPhysicsLoop);
-	DeactivateEngineLoop(DuringPhysicsLoop);
-	DeactivateEngineLoop(EndPhysicsLoop);
-	DeactivateEngineLoop(PostPhysicsLoop);
-	DeactivateEngineLoop(FrameEndLoop);
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	StartedWorld.Reset();
+	
+	if (SimulationThread)
+	{
+		SimulationThread->StopThread();
+		
+		for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+		{
+			EngineLoop->RemovePrerequisite(this, SimulationSyncTick);
+		}
+		SimulationSyncTick.SetTickFunctionEnable(false);
+		SimulationSyncTick.UnRegisterTickFunction();
+	}
+	
+	for (FM2EngineLoop* EngineLoop : GetEngineLoops())
+	{
+		DeactivateEngineLoop(*EngineLoop);
+	}
 
 	EngineState = EM2EngineState::Stopped;
 	M2_LOG_OBJECT(this, LogM2, Log, TEXT("M2Engine stopped."));
 }
 
+FName UM2Engine::GetStreamingCellName(const ULevel& Level)
+{
+	return Level.GetPackage()->GetFName();
+}
+
+void UM2Engine::HandleLevelAddedToWorld(ULevel* Level, UWorld* World)
+{
+	if (Level && World && World == StartedWorld.Get())
+	{
+		// Goes through the command queue in case the simulation thread owns the registry.
+		EnqueueSimulationCommand([CellName = GetStreamingCellName(*Level)](UM2Registry& InRegistry) { InRegistry.LoadCell(CellName); });
+	}
+}
+
+void UM2Engine::HandleLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	// A null level means the whole world is going away, which Stop takes care of.
+	if (Level && World && World == StartedWorld.Get())
+	{
+		EnqueueSimulationCommand([CellName = GetStreamingCellName(*Level)](UM2Registry& InRegistry) { InRegistry.UnloadCell(CellName); });
+	}
+}
+
+void UM2Engine::Step(float DeltaTime, int32 NumSteps)
+{
+	if (EngineState == EM2EngineState::Initialize)
+	{
+		M2_LOG_OBJECT(this, LogM2, Error, TEXT("Unable to step M2Engine: FinishConfiguration has not been called."));
+		return;
+	}
+	if (EngineState == EM2EngineState::Started)
+	{
+		M2_LOG_OBJECT(this, LogM2, Error, TEXT("Unable to step M2Engine: The engine is already ticking with a world."));
+		return;
+	}
+
+	const TArray<FM2EngineLoop*>& EngineLoops = OrderedEngineLoops;
+	for (FM2EngineLoop* EngineLoop : EngineLoops)
+	{
+		EngineLoop->OperationContext.Registry = Registry.Get();
+		EngineLoop->OperationContext.World = nullptr;
+		EngineLoop->OperationContext.bHeadless = true;
+	}
+	
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		for (FM2EngineLoop* EngineLoop : EngineLoops)
+		{
+			if (!EngineLoop->Options.OperationGroups.IsEmpty())
+			{
+				EngineLoop->RunLoop(DeltaTime);
+			}
+		}
+		
+		if (SimulationThread)
+		{
+			// Headless stepping drives the simulation loop inline instead of on its own thread.
+			SimulationThread->StepSimulation(DeltaTime);
+			SimulationThread->Publish();
+		}
+	}
+	
+	for (FM2EngineLoop* EngineLoop : EngineLoops)
+	{
+		EngineLoop->OperationContext.Registry = nullptr;
+		EngineLoop->OperationContext.bHeadless = false;
+	}
+}
+
 void UM2Engine::ResetCounters()
 {
 	SET_DWORD_STAT(STAT_M2_TempararyEntitiesAdded, 0);
@@ -215,10 +840,39 @@ void UM2Engine::ActivateEngineLoop(FM2EngineLoop& TickFunction, UWorld& World)
 {
 	TickFunction.OperationContext.Registry = Registry.Get();
 	TickFunction.OperationContext.World = &World;
+	TickFunction.OperationContext.bHeadless = false;
+	TickFunction.TimeAccumulator = 0.0f;
+
+	for (FM2OperationGroup& OperationGroup : TickFunction.Options.OperationGroups)
+	{
+		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+		{
+			if (Operation.IsValid())
+			{
+				Operation->ResetTickInterval();
+			}
+		}
+	}
 	TickFunction.RegisterTickFunction(World.PersistentLevel);
 	TickFunction.SetTickFunctionEnable(true);
 }
 
+bool UM2Engine::CanRunAlongsideSimulation(const FM2EngineLoop& EngineLoop) const
+{
+	for (const FM2OperationGroup& OperationGroup : EngineLoop.Options.OperationGroups)
+	{
+		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+		{
+			if (Operation.IsValid() && Operation->AccessesRegistry())
+			{
+				M2_LOG(LogM2, Error, TEXT("Phase %s will not run: Operation %s accesses the registry, which the simulation thread owns while it runs."), *EngineLoop.PhaseName.ToString(), *Operation->GetClass()->GetName());
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 void UM2Engine::DeactivateEngineLoop(FM2EngineLoop& TickFunction)
 {
 	TickFunction.SetTickFunctionEnable(false);
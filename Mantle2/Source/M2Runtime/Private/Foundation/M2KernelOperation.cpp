@@ -0,0 +1,99 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2KernelOperation.h"
+
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+bool UM2KernelOperation::CanFuseWith(const UM2KernelOperation& Other) const
+{
+	// Throttled and deferrable kernels decide for themselves when to run, so they can't share a pass.
+	if (!bAllowFusion || !Other.bAllowFusion || IsThrottled() || Other.IsThrottled() || bDeferrable || Other.bDeferrable)
+	{
+		return false;
+	}
+	
+	return QuerySets == Other.QuerySets;
+}
+
+void UM2FusedKernelOperation::AddKernel(UM2KernelOperation& Kernel)
+{
+	Kernels.Add(&Kernel);
+}
+
+void UM2FusedKernelOperation::Initialize(UM2Registry* Registry)
+{
+	if (Kernels.IsEmpty())
+	{
+		M2_LOG(LogM2, Error, TEXT("Fused kernel operation has no kernels."));
+		return;
+	}
+
+	// Fused kernels all share the first kernel's query, and its execution settings.
+	QuerySets = Kernels[0]->QuerySets;
+	Execution = Kernels[0]->Execution;
+	ChunkSizeOverride = Kernels[0]->ChunkSizeOverride;
+	
+	Priority = EM2OperationPriority::Low;
+	for (const TObjectPtr<UM2KernelOperation>& Kernel : Kernels)
+	{
+		Priority = FMath::Max(Priority, Kernel->Priority);
+	}
+}
+
+bool UM2FusedKernelOperation::IsThreadSafe() const
+{
+	for (const TObjectPtr<UM2KernelOperation>& Kernel : Kernels)
+	{
+		if (!Kernel->IsThreadSafe())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void UM2FusedKernelOperation::ProcessChunk(const FM2OperationContext& Ctx, const FM2RecordChunk& Chunk)
+{
+	for (const TObjectPtr<UM2KernelOperation>& Kernel : Kernels)
+	{
+		Kernel->ProcessChunk(Ctx, Chunk);
+	}
+}
+
+void UM2FusedKernelOperation::PostProcessChunks(FM2OperationContext& Ctx)
+{
+	for (const TObjectPtr<UM2KernelOperation>& Kernel : Kernels)
+	{
+		Kernel->PostProcessChunks(Ctx);
+	}
+}
@@ -32,6 +32,7 @@
 #include "Foundation/M2Operation.h"
 
 #include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
 
 UM2Operation::~UM2Operation()
 {
@@ -40,7 +41,7 @@ UM2Operation::~UM2Operation()
 
 void UM2Operation::Run(FM2OperationContext& Ctx)
 {
-	if (!Ctx.World.IsValid())
+	if (!Ctx.bHeadless && !Ctx.World.IsValid())
 	{
 		return;
 	}
@@ -52,6 +53,88 @@ void UM2Operation::Run(FM2OperationContext& Ctx)
 	PerformOperation(Ctx);
 }
 
+bool UM2Operation::ConsumeTickInterval(float DeltaTime, float& OutDeltaTime)
+{
+	AccumulatedDeltaTime += DeltaTime;
+	IterationsSinceLastRun++;
+
+	if (IterationsSinceLastRun < TickIntervalFrames || AccumulatedDeltaTime < TickIntervalSec)
+	{
+		return false;
+	}
+
+	OutDeltaTime = AccumulatedDeltaTime;
+	AccumulatedDeltaTime = 0.0f;
+	IterationsSinceLastRun = 0;
+	return true;
+}
+
+void UM2Operation::ResetTickInterval()
+{
+	// Starting the counter below the interval by PhaseOffset pushes every run back by that many iterations. 
+	IterationsSinceLastRun = FMath::Max(TickIntervalFrames, 1) - 1 - FMath::Max(PhaseOffset, 0);
+	AccumulatedDeltaTime = 0.0f;
+}
+
+bool UM2Operation::ShouldDefer(double ElapsedMs, double BudgetMs, int32 MaxDeferrals) const
+{
+	if (!bDeferrable || Priority == EM2OperationPriority::High)
+	{
+		return false;
+	}
+
+	if (Priority == EM2OperationPriority::Low)
+	{
+		return ConsecutiveDeferrals < MaxDeferrals && ElapsedMs + AverageCostMs > BudgetMs;
+	}
+	
+	return ConsecutiveDeferrals < FMath::Max(MaxDeferrals / 2, 1) && ElapsedMs > BudgetMs;
+}
+
+void UM2Operation::Defer(float DeltaTime)
+{
+	DeferredDeltaTime += DeltaTime;
+	ConsecutiveDeferrals++;
+	TotalDeferrals++;
+
+	M2_LOG(LogM2, Verbose, TEXT("Operation %s deferred (%d in a row)."), *GetClass()->GetName(), ConsecutiveDeferrals);
+
+	INC_DWORD_STAT(STAT_M2_OperationsDeferred);
+#if STATS
+	if (DeferralStatId.IsSet())
+	{
+		INC_DWORD_STAT_FNAME_BY(DeferralStatId->GetName(), 1);
+	}
+#endif
+}
+
+void UM2Operation::CreateStats()
+{
+	ensure(IsInGameThread());
+	
+#if STATS
+	if (bDeferrable && !DeferralStatId.IsSet())
+	{
+		DeferralStatId = FDynamicStats::CreateStatIdInt64<FStatGroup_STATGROUP_M2>(FString::Printf(TEXT("Deferred: %s"), *GetClass()->GetName()));
+	}
+#endif
+}
+
+float UM2Operation::ConsumeDeferredTime()
+{
+	const float DeltaTime = DeferredDeltaTime;
+	DeferredDeltaTime = 0.0f;
+	ConsecutiveDeferrals = 0;
+	return DeltaTime;
+}
+
+void UM2Operation::RecordCost(double CostMs)
+{
+	// An exponential moving average, so a single slow frame doesn't get the operation deferred for long.
+	constexpr double Smoothing = 0.2;
+	AverageCostMs = AverageCostMs <= 0.0 ? CostMs : FMath::Lerp(AverageCostMs, CostMs, Smoothing);
+}
+
 void UM2Operation::PerformOperation(FM2OperationContext& Ctx)
 {
 	UE_LOG(LogM2, Error, TEXT("PerformOperation must be overriden."));	
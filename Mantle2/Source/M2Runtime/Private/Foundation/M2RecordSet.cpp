@@ -41,6 +41,7 @@ void UM2RecordSet::PreInitialize(FGuid NewSetId)
 
 	AddRecordFns.Empty();
 	RemoveRecordFns.Empty();
+	MoveRecordFns.Empty();
 	GetFieldFns.Empty();
 	Archetype.Empty();
 }
@@ -71,9 +72,9 @@ bool UM2RecordSet::MatchArchetype(TArray<UScriptStruct*>& Match, TArray<UScriptS
 	return (Match.Num() + Exclude.Num()) > 0;
 }
 
-FM2RecordHandle UM2RecordSet::AddRecordInternal(int32& OutRecordIndex)
+FM2RecordHandle UM2RecordSet::AddRecordInternal(int32& OutRecordIndex, const FGuid& RecordId)
 {
-	RecordHandles.Add(FM2RecordHandle(SetId, FGuid::NewGuid()));
+	RecordHandles.Add(FM2RecordHandle(SetId, RecordId.IsValid() ? RecordId : FGuid::NewGuid()));
 	OutRecordIndex = RecordHandles.Num() - 1;
 	RecordIndexMap.Add(RecordHandles.Last().RecordId, OutRecordIndex);
 	for (TFunction<void()> AddFunction : AddRecordFns)
@@ -98,6 +99,11 @@ FM2RecordHandle UM2RecordSet::AddAndInitializeRecord(const FGameplayTag& InitID)
 }
 
 void UM2RecordSet::RemoveRecord(const FM2RecordHandle& RecordHandle)
+{
+	RemoveRecordInternal(RecordHandle, false);
+}
+
+void UM2RecordSet::RemoveRecordInternal(const FM2RecordHandle& RecordHandle, bool bSkipHooks)
 {
 	if (!RecordHandle.SetId.IsValid() || RecordHandle.SetId != SetId)
 	{
@@ -116,6 +122,14 @@ void UM2RecordSet::RemoveRecord(const FM2RecordHandle& RecordHandle)
 		return;
 	}
 
+	if (!bSkipHooks)
+	{
+		PreRemoveRecord(RecordHandle, RecordIndex);
+	}
+
+	// RecordHandle may point into RecordHandles, so keep a copy around for the broadcast below.
+	const FM2RecordHandle RemovedHandle = RecordHandle;
+
 	for (TFunction<void(int32)> RemoveFn : RemoveRecordFns)
 	{
 		RemoveFn(RecordIndex);
@@ -132,6 +146,160 @@ void UM2RecordSet::RemoveRecord(const FM2RecordHandle& RecordHandle)
 		check(RecordHandles[RecordIndex].RecordId == LastId);
 		RecordIndexMap[LastId] = RecordIndex;	
 	}
+
+	RecordRemovedDelegate.Broadcast(RemovedHandle, RecordIndex);
+}
+
+FM2RecordHandle UM2RecordSet::MoveRecordFrom(UM2RecordSet& Source, const FM2RecordHandle& RecordHandle)
+{
+	if (&Source == this || Source.GetClass() != GetClass())
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to move record: Records can only be moved between different sets of the same type."));
+		return FM2RecordHandle();
+	}
+
+	const int32 SourceIndex = Source.GetRecordIndex(RecordHandle);
+	if (SourceIndex == INDEX_NONE)
+	{
+		return FM2RecordHandle();
+	}
+
+	// Copy the handle first, since RecordHandle may point into the source set's handle array.
+	const FM2RecordHandle OldHandle = RecordHandle;
+	
+	int32 RecordIndex;
+	const FM2RecordHandle NewHandle = AddRecordInternal(RecordIndex, OldHandle.RecordId);
+	for (TFunction<void(UM2RecordSet&, int32)>& MoveFn : MoveRecordFns)
+	{
+		MoveFn(Source, SourceIndex);
+	}
+
+	Source.RemoveRecordInternal(OldHandle, true);
+	PostMoveRecord(Source, OldHandle, NewHandle, RecordIndex);
+	return NewHandle;
+}
+
+int32 UM2RecordSet::SaveRecords(FArchive& Ar, TConstArrayView<FM2RecordHandle> Handles)
+{
+	check(Ar.IsSaving());
+
+	TArray<UScriptStruct*> FieldTypes;
+	GetFieldFns.GetKeys(FieldTypes);
+	
+	int32 NumFields = FieldTypes.Num();
+	Ar << NumFields;
+	for (UScriptStruct* FieldType : FieldTypes)
+	{
+		FString FieldPath = FieldType->GetPathName();
+		Ar << FieldPath;
+	}
+
+	TArray<FM2RecordHandle> SavedHandles;
+	for (const FM2RecordHandle& Handle : Handles)
+	{
+		if (HasRecord(Handle))
+		{
+			SavedHandles.Add(Handle);
+		}
+	}
+	
+	int32 NumRecords = SavedHandles.Num();
+	Ar << NumRecords;
+	for (FM2RecordHandle& Handle : SavedHandles)
+	{
+		Ar << Handle.RecordId;
+
+		const int32 RecordIndex = RecordIndexMap.FindChecked(Handle.RecordId);
+		for (UScriptStruct* FieldType : FieldTypes)
+		{
+			FieldType->SerializeItem(Ar, GetFieldData(FieldType, RecordIndex), nullptr);
+		}
+	}
+
+	for (const FM2RecordHandle& Handle : SavedHandles)
+	{
+		RemoveRecord(Handle);
+	}
+	
+	return NumRecords;
+}
+
+bool UM2RecordSet::LoadRecords(FArchive& Ar, TArray<FM2RecordHandle>& OutHandles)
+{
+	check(Ar.IsLoading());
+	
+	int32 NumFields = 0;
+	Ar << NumFields;
+
+	// This can run on the simulation thread, so the saved fields are matched against this set's own field types rather
+	// than looked up as objects.
+	TArray<UScriptStruct*> KnownFieldTypes;
+	GetFieldFns.GetKeys(KnownFieldTypes);
+	
+	TArray<UScriptStruct*> FieldTypes;
+	for (int32 FieldIndex = 0; FieldIndex < NumFields; ++FieldIndex)
+	{
+		FString FieldPath;
+		Ar << FieldPath;
+
+		UScriptStruct* const* FieldType = KnownFieldTypes.FindByPredicate([&FieldPath](const UScriptStruct* KnownFieldType) { return KnownFieldType->GetPathName() == FieldPath; });
+		if (!FieldType)
+		{
+			M2_LOG(LogM2, Error, TEXT("Unable to load records into %s: Unknown field %s."), *GetName(), *FieldPath);
+			return false;
+		}
+		FieldTypes.Add(*FieldType);
+	}
+
+	int32 NumRecords = 0;
+	Ar << NumRecords;
+	
+	TArray<FM2RecordHandle> LoadedHandles;
+	LoadedHandles.Reserve(NumRecords);
+	bool bSucceeded = true;
+	
+	for (int32 Count = 0; Count < NumRecords && !Ar.IsError(); ++Count)
+	{
+		FGuid RecordId;
+		Ar << RecordId;
+		if (RecordIndexMap.Contains(RecordId))
+		{
+			M2_LOG(LogM2, Error, TEXT("Unable to load records into %s: Record %s is already loaded."), *GetName(), *RecordId.ToString());
+			bSucceeded = false;
+			break;
+		}
+
+		int32 RecordIndex;
+		LoadedHandles.Add(AddRecordInternal(RecordIndex, RecordId));
+		for (UScriptStruct* FieldType : FieldTypes)
+		{
+			FieldType->SerializeItem(Ar, GetFieldData(FieldType, RecordIndex), nullptr);
+		}
+	}
+
+	if (!bSucceeded || Ar.IsError())
+	{
+		// None of these records went through PostLoadRecord, so they leave without going through PreRemoveRecord.
+		for (const FM2RecordHandle& Handle : LoadedHandles)
+		{
+			RemoveRecordInternal(Handle, true);
+		}
+		return false;
+	}
+
+	for (const FM2RecordHandle& Handle : LoadedHandles)
+	{
+		PostLoadRecord(Handle, RecordIndexMap.FindChecked(Handle.RecordId));
+	}
+	OutHandles.Append(LoadedHandles);
+	return true;
+}
+
+uint8* UM2RecordSet::GetFieldData(UScriptStruct* FieldType, int32 RecordIndex)
+{
+	// The view's element type doesn't matter here, only where the column starts.
+	uint8* ColumnData = GetFieldInternal(FieldType).GetArrayView<uint8>().GetData();
+	return ColumnData + RecordIndex * FieldType->GetStructureSize();
 }
 
 FAnankeUntypedArrayView UM2RecordSet::GetFieldInternal(UScriptStruct* ComponentType)
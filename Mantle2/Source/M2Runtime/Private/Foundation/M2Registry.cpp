@@ -31,10 +31,25 @@
 
 #include "Foundation/M2Registry.h"
 
+#include "Foundation/M2BoundsTree.h"
+#include "Foundation/M2SpatialIndex.h"
 #include "Logging/M2LoggingDefs.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
 #include "Logging/M2LoggingMacros.h"
 #include "Testing/M2TestTables.h"
 
+FIntVector FM2ShardGrid::GetCell(const FVector& Position) const
+{
+	const FVector Local = (Position - Bounds.Min) / CellSize;
+	return FIntVector(
+		FMath::Clamp(FMath::FloorToInt32(Local.X), 0, NumCells.X - 1),
+		FMath::Clamp(FMath::FloorToInt32(Local.Y), 0, NumCells.Y - 1),
+		FMath::Clamp(FMath::FloorToInt32(Local.Z), 0, NumCells.Z - 1)
+	);
+}
+
 bool UM2Registry::HasRecord(const FM2RecordHandle& RecordHandle)
 {
 	return (
@@ -59,7 +74,23 @@ void UM2Registry::RemoveRecord(const FM2RecordHandle& RecordHandle)
 		return;
 	}
 
-	Result->Get()->RemoveRecord(RecordHandle);
+	UM2RecordSet* RecordSet = Result->Get();
+	if (!RecordSet->HasRecord(RecordHandle))
+	{
+		return;
+	}
+
+	// Copy the handle first, in case it points into the record set's handle array.
+	const FM2RecordHandle RemovedHandle = RecordHandle;
+	RecordSet->RemoveRecord(RemovedHandle);
+
+	FName CellName;
+	if (RecordCells.RemoveAndCopyValue(RemovedHandle, CellName))
+	{
+		CellRecords.FindChecked(CellName).Remove(RemovedHandle);
+	}
+	
+	RecordRemovedDelegate.Broadcast(RemovedHandle);
 }
 
 TArray<UM2RecordSet*> UM2Registry::GetAll(TArray<TSubclassOf<UM2RecordSet>>& RecordTypes)
@@ -73,6 +104,11 @@ TArray<UM2RecordSet*> UM2Registry::GetAll(TArray<TSubclassOf<UM2RecordSet>>& Rec
 			continue;
 		}
 		Result.Add(SetsByType.FindChecked(RecordType));
+
+		if (const FM2ShardGrid* ShardGrid = ShardGrids.Find(RecordType))
+		{
+			Result.Append(ShardGrid->Shards);
+		}
 	}
 	
 	return Result;
@@ -89,12 +125,344 @@ TArray<UM2RecordSet*> UM2Registry::GetAll(TArray<UScriptStruct*>& Match, TArray<
 		if (TargetSet->MatchArchetype(Match, Exclude))
 		{
 			Result.Add(TargetSet);
+
+			if (const FM2ShardGrid* ShardGrid = ShardGrids.Find(Iterator.Key()))
+			{
+				Result.Append(ShardGrid->Shards);
+			}
+		}
+	}
+	
+	return Result;
+}
+
+TArray<UM2RecordSet*> UM2Registry::GetAll(TArray<UScriptStruct*>& Match, TArray<UScriptStruct*>& Exclude, const FBox& Region)
+{
+	TArray<UM2RecordSet*> Result;
+
+	for (auto Iterator = SetsByType.CreateConstIterator(); Iterator; ++Iterator)
+	{
+		UM2RecordSet* TargetSet = Iterator.Value();
+		if (!TargetSet->MatchArchetype(Match, Exclude))
+		{
+			continue;
+		}
+		
+		// The main set holds records that haven't been placed in a shard yet, so it could be anywhere.
+		Result.Add(TargetSet);
+		
+		const FM2ShardGrid* ShardGrid = ShardGrids.Find(Iterator.Key());
+		if (!ShardGrid)
+		{
+			continue;
+		}
+
+		const FIntVector MinCell = ShardGrid->GetCell(Region.Min);
+		const FIntVector MaxCell = ShardGrid->GetCell(Region.Max);
+		for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+				{
+					Result.Add(ShardGrid->Shards[ShardGrid->GetShardIndex(FIntVector(X, Y, Z))]);
+				}
+			}
 		}
 	}
 	
 	return Result;
 }
 
+bool UM2Registry::EnableShardingInternal(TSubclassOf<UM2RecordSet> RecordType, const FBox& Bounds, float CellSize, TFunction<void(UM2RecordSet&, TArray<FVector>&)>&& GetPositions)
+{
+	if (!SetsByType.Contains(RecordType))
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to shard %s: The registry has no set of that type."), *GetNameSafe(RecordType));
+		return false;
+	}
+	if (ShardGrids.Contains(RecordType))
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to shard %s: The type is already sharded."), *RecordType->GetName());
+		return false;
+	}
+	if (!Bounds.IsValid || CellSize <= 0.0f)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to shard %s: Bounds must be valid and CellSize must be greater than zero."), *RecordType->GetName());
+		return false;
+	}
+
+	FM2ShardGrid& ShardGrid = ShardGrids.Add(RecordType);
+	ShardGrid.Bounds = Bounds;
+	ShardGrid.CellSize = CellSize;
+	ShardGrid.GetPositions = MoveTemp(GetPositions);
+
+	const FVector Size = Bounds.GetSize();
+	ShardGrid.NumCells = FIntVector(
+		FMath::Max(FMath::CeilToInt32(Size.X / CellSize), 1),
+		FMath::Max(FMath::CeilToInt32(Size.Y / CellSize), 1),
+		FMath::Max(FMath::CeilToInt32(Size.Z / CellSize), 1)
+	);
+
+	// Shards are created up front, so operations that look up their sets once still see every shard.
+	const int32 NumShards = ShardGrid.NumCells.X * ShardGrid.NumCells.Y * ShardGrid.NumCells.Z;
+	for (int32 ShardIndex = 0; ShardIndex < NumShards; ++ShardIndex)
+	{
+		auto* NewRecordSet = NewObject<UM2RecordSet>(this, RecordType);
+		FGuid NewId = FGuid::NewGuid();
+		NewRecordSet->PreInitialize(NewId);
+		NewRecordSet->Initialize();
+		SetsById.Add(NewId, NewRecordSet);
+		ShardGrid.Shards.Add(NewRecordSet);
+	}
+
+	M2_LOG_OBJECT(this, LogM2, Log, TEXT("Sharded %s into %d x %d x %d cells."), *RecordType->GetName(), ShardGrid.NumCells.X, ShardGrid.NumCells.Y, ShardGrid.NumCells.Z);
+	return true;
+}
+
+int32 UM2Registry::MigrateShardedRecords()
+{
+	int32 NumMoved = 0;
+	TArray<FVector> Positions;
+	TArray<TPair<FM2RecordHandle, UM2RecordSet*>> Moves;
+	
+	for (TPair<TSubclassOf<UM2RecordSet>, FM2ShardGrid>& Pair : ShardGrids)
+	{
+		FM2ShardGrid& ShardGrid = Pair.Value;
+		
+		TArray<UM2RecordSet*, TInlineAllocator<64>> SourceSets;
+		SourceSets.Add(SetsByType.FindChecked(Pair.Key));
+		SourceSets.Append(ShardGrid.Shards);
+
+		// Collect every move before making any, since moving records reorders the sets.
+		Moves.Reset();
+		for (UM2RecordSet* SourceSet : SourceSets)
+		{
+			ShardGrid.GetPositions(*SourceSet, Positions);
+			TArrayView<FM2RecordHandle> Handles = SourceSet->GetHandles();
+			
+			for (int32 RecordIndex = 0; RecordIndex < Positions.Num(); ++RecordIndex)
+			{
+				UM2RecordSet* TargetSet = ShardGrid.Shards[ShardGrid.GetShardIndex(ShardGrid.GetCell(Positions[RecordIndex]))];
+				if (TargetSet != SourceSet)
+				{
+					Moves.Emplace(Handles[RecordIndex], TargetSet);
+				}
+			}
+		}
+
+		for (const TPair<FM2RecordHandle, UM2RecordSet*>& Move : Moves)
+		{
+			if (MoveRecord(Move.Key, *Move.Value).IsSet())
+			{
+				NumMoved++;
+			}
+		}
+	}
+
+	return NumMoved;
+}
+
+FM2RecordHandle UM2Registry::MoveRecord(const FM2RecordHandle& RecordHandle, UM2RecordSet& TargetSet)
+{
+	UM2RecordSet* SourceSet = GetRecordSet(RecordHandle);
+	if (!SourceSet || !SourceSet->HasRecord(RecordHandle))
+	{
+		return FM2RecordHandle();
+	}
+
+	const FM2RecordHandle OldHandle = RecordHandle;
+	const FM2RecordHandle NewHandle = TargetSet.MoveRecordFrom(*SourceSet, OldHandle);
+	if (!NewHandle.IsSet())
+	{
+		return NewHandle;
+	}
+
+	FName CellName;
+	if (RecordCells.RemoveAndCopyValue(OldHandle, CellName))
+	{
+		AssignRecordToCell(NewHandle, CellName);
+	}
+	
+	RecordMovedDelegate.Broadcast(OldHandle, NewHandle);
+	return NewHandle;
+}
+
+void UM2Registry::AssignRecordToCell(const FM2RecordHandle& RecordHandle, FName CellName)
+{
+	if (!HasRecord(RecordHandle))
+	{
+		return;
+	}
+
+	FName OldCellName;
+	if (RecordCells.RemoveAndCopyValue(RecordHandle, OldCellName))
+	{
+		CellRecords.FindChecked(OldCellName).Remove(RecordHandle);
+	}
+	
+	if (!CellName.IsNone())
+	{
+		RecordCells.Add(RecordHandle, CellName);
+		CellRecords.FindOrAdd(CellName).Add(RecordHandle);
+	}
+}
+
+FName UM2Registry::GetRecordCell(const FM2RecordHandle& RecordHandle) const
+{
+	const FName* CellName = RecordCells.Find(RecordHandle);
+	return CellName ? *CellName : NAME_None;
+}
+
+int32 UM2Registry::UnloadCell(FName CellName)
+{
+	if (UnloadedCells.Contains(CellName))
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to unload cell %s: The cell is already unloaded."), *CellName.ToString());
+		return 0;
+	}
+	
+	TSet<FM2RecordHandle>* Records = CellRecords.Find(CellName);
+	if (!Records || Records->IsEmpty())
+	{
+		return 0;
+	}
+
+	// Group the records by set, so each set writes its field layout once.
+	TMap<UM2RecordSet*, TArray<FM2RecordHandle>> RecordsBySet;
+	for (const FM2RecordHandle& RecordHandle : *Records)
+	{
+		if (UM2RecordSet* RecordSet = GetRecordSet(RecordHandle))
+		{
+			RecordsBySet.FindOrAdd(RecordSet).Add(RecordHandle);
+		}
+	}
+
+	TArray<uint8>& Blob = UnloadedCells.Add(CellName);
+	FMemoryWriter MemoryWriter(Blob);
+	FObjectAndNameAsStringProxyArchive Writer(MemoryWriter, false);
+
+	int32 NumSets = RecordsBySet.Num();
+	Writer << NumSets;
+	
+	int32 NumUnloaded = 0;
+	for (TPair<UM2RecordSet*, TArray<FM2RecordHandle>>& Pair : RecordsBySet)
+	{
+		FGuid SetId = Pair.Key->GetSetId();
+		Writer << SetId;
+		NumUnloaded += Pair.Key->SaveRecords(Writer, Pair.Value);
+	}
+	
+	// The records are gone until the cell is loaded, which puts them back in it.
+	for (const FM2RecordHandle& RecordHandle : *Records)
+	{
+		RecordCells.Remove(RecordHandle);
+	}
+	CellRecords.Remove(CellName);
+	Blob.Shrink();
+
+	M2_LOG_OBJECT(this, LogM2, Verbose, TEXT("Unloaded %d records from cell %s into %d bytes."), NumUnloaded, *CellName.ToString(), Blob.Num());
+	return NumUnloaded;
+}
+
+int32 UM2Registry::LoadCell(FName CellName)
+{
+	TArray<uint8>* Blob = UnloadedCells.Find(CellName);
+	if (!Blob)
+	{
+		return 0;
+	}
+	
+	// Cells are loaded from the simulation thread when there is one, where loading packages isn't allowed. Objects the
+	// records refer to (ie: payload types) are only looked up, and the step holds off garbage collection meanwhile.
+	FMemoryReader MemoryReader(*Blob);
+	FObjectAndNameAsStringProxyArchive Reader(MemoryReader, false);
+
+	int32 NumSets = 0;
+	Reader << NumSets;
+
+	TArray<FM2RecordHandle> LoadedHandles;
+	int32 NumLoadedSets = 0;
+	int64 FailedSetOffset = INDEX_NONE;
+	for (; NumLoadedSets < NumSets; ++NumLoadedSets)
+	{
+		const int64 SetOffset = Reader.Tell();
+		FGuid SetId;
+		Reader << SetId;
+
+		// Sets either load all of their records or none of them, so a failed set can be put back as it was.
+		TObjectPtr<UM2RecordSet>* RecordSet = SetsById.Find(SetId);
+		if (!RecordSet || !RecordSet->Get()->LoadRecords(Reader, LoadedHandles))
+		{
+			// The rest of the blob can't be read without knowing this set's layout.
+			M2_LOG(LogM2, Error, TEXT("Unable to load cell %s: Failed to load records for set %s. The cell's remaining %d sets stay unloaded."), *CellName.ToString(), *SetId.ToString(), NumSets - NumLoadedSets);
+			FailedSetOffset = SetOffset;
+			break;
+		}
+	}
+
+	for (const FM2RecordHandle& RecordHandle : LoadedHandles)
+	{
+		AssignRecordToCell(RecordHandle, CellName);
+	}
+
+	if (FailedSetOffset == INDEX_NONE)
+	{
+		UnloadedCells.Remove(CellName);
+		return LoadedHandles.Num();
+	}
+
+	// Keep the sets that didn't load, so their records aren't lost and the cell can be loaded again later.
+	TArray<uint8> Remainder;
+	FMemoryWriter MemoryWriter(Remainder);
+	int32 NumRemainingSets = NumSets - NumLoadedSets;
+	MemoryWriter << NumRemainingSets;
+	Remainder.Append(Blob->GetData() + FailedSetOffset, Blob->Num() - FailedSetOffset);
+	*Blob = MoveTemp(Remainder);
+	
+	return LoadedHandles.Num();
+}
+
+int64 UM2Registry::GetUnloadedCellSize(FName CellName) const
+{
+	const TArray<uint8>* Blob = UnloadedCells.Find(CellName);
+	return Blob ? Blob->Num() : 0;
+}
+
+UM2SpatialIndex* UM2Registry::GetSpatialIndex(UScriptStruct* PositionField) const
+{
+	const TObjectPtr<UM2SpatialIndex>* Result = SpatialIndices.Find(PositionField);
+	return Result ? Result->Get() : nullptr;
+}
+
+void UM2Registry::UpdateSpatialIndices()
+{
+	for (auto& [PositionField, SpatialIndex] : SpatialIndices)
+	{
+		if (SpatialIndex)
+		{
+			SpatialIndex->Update();
+		}
+	}
+}
+
+UM2BoundsTree* UM2Registry::GetBoundsTree(UScriptStruct* BoundsField) const
+{
+	const TObjectPtr<UM2BoundsTree>* Result = BoundsTrees.Find(BoundsField);
+	return Result ? Result->Get() : nullptr;
+}
+
+void UM2Registry::UpdateBoundsTrees()
+{
+	for (auto& [BoundsField, BoundsTree] : BoundsTrees)
+	{
+		if (BoundsTree)
+		{
+			BoundsTree->Update();
+		}
+	}
+}
+
 void UM2Registry::ConstructRecordSets()
 {
 	TArray<FString> AllValidSets;
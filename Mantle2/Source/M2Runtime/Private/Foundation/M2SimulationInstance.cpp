@@ -0,0 +1,146 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2SimulationInstance.h"
+
+#include "Async/ParallelFor.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+void UM2SimulationInstance::Initialize(TSubclassOf<UM2Registry> RegistryClass)
+{
+	if (Registry)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Simulation instance %s is already initialized."), *GetName());
+		return;
+	}
+	if (!RegistryClass)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to initialize simulation instance: Invalid RegistryClass."));
+		return;
+	}
+
+	Registry = NewObject<UM2Registry>(this, RegistryClass);
+	Registry->ConstructRecordSets();
+	Loop.PhaseName = GetFName();
+}
+
+void UM2SimulationInstance::ConfigureLoop(const FM2EngineLoopOptions& Options)
+{
+	if (bConfigured)
+	{
+		M2_LOG(LogM2, Warning, TEXT("Unable to configure simulation instance: Instance has already been configured."));
+		return;
+	}
+
+	Loop.ApplyOptions(Options);
+}
+
+void UM2SimulationInstance::FinishConfiguration()
+{
+	if (!Registry)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to finish configuring simulation instance: Initialize has not been called."));
+		return;
+	}
+	
+	for (TObjectPtr<UM2Operation> Operation : Operations)
+	{
+		Operation->Initialize(Registry);
+		Operation->CreateStats();
+	}
+
+	// Fuses kernels and staggers throttled operations exactly like the engine's loops.
+	Loop.FinishConfiguration(*this, *Registry, Operations);
+
+	for (FM2OperationGroup& OperationGroup : Loop.Options.OperationGroups)
+	{
+		for (TWeakObjectPtr<UM2Operation> Operation : OperationGroup.Operations)
+		{
+			if (!Operation.IsValid())
+			{
+				continue;
+			}
+			
+			if (!Operation->IsThreadSafe())
+			{
+				M2_LOG(LogM2, Log, TEXT("Operation %s is not thread safe. Simulation instance %s will be stepped on the calling thread."), *Operation->GetClass()->GetName(), *GetName());
+				bThreadSafe = false;
+			}
+		}
+	}
+
+	Loop.OperationContext.Registry = Registry.Get();
+	Loop.OperationContext.World = nullptr;
+	Loop.OperationContext.bHeadless = true;
+	bConfigured = true;
+}
+
+void UM2SimulationInstance::Step(float DeltaTime, int32 NumSteps)
+{
+	if (!bConfigured)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to step simulation instance %s: FinishConfiguration has not been called."), *GetName());
+		return;
+	}
+
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		Loop.RunLoop(DeltaTime);
+	}
+}
+
+void UM2SimulationInstance::StepInstances(TConstArrayView<UM2SimulationInstance*> Instances, float DeltaTime, int32 NumSteps)
+{
+	TArray<UM2SimulationInstance*> ParallelInstances;
+	TArray<UM2SimulationInstance*> SerialInstances;
+	for (UM2SimulationInstance* Instance : Instances)
+	{
+		if (Instance)
+		{
+			(Instance->IsThreadSafe() ? ParallelInstances : SerialInstances).Add(Instance);
+		}
+	}
+
+	// Instances can differ a lot in size, so hand them out one at a time.
+	ParallelFor(
+		TEXT("M2SimulationInstance"),
+		ParallelInstances.Num(),
+		1,
+		[&ParallelInstances, DeltaTime, NumSteps](int32 InstanceIndex) { ParallelInstances[InstanceIndex]->Step(DeltaTime, NumSteps); },
+		EParallelForFlags::Unbalanced
+	);
+
+	for (UM2SimulationInstance* Instance : SerialInstances)
+	{
+		Instance->Step(DeltaTime, NumSteps);
+	}
+}
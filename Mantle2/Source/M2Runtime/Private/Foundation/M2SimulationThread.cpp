@@ -0,0 +1,140 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2SimulationThread.h"
+
+#include "Foundation/M2Engine.h"
+#include "HAL/RunnableThread.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+#include "UObject/GarbageCollection.h"
+
+FM2SimulationThread::FM2SimulationThread(FM2EngineLoop& InSimulationLoop, UM2Registry& InRegistry, float InTickRateHz)
+	: SimulationLoop(InSimulationLoop), Registry(InRegistry), TickRateHz(InTickRateHz)
+{
+}
+
+FM2SimulationThread::~FM2SimulationThread()
+{
+	StopThread();
+}
+
+void FM2SimulationThread::StartThread()
+{
+	if (Thread)
+	{
+		return;
+	}
+	
+	if (TickRateHz <= 0.0f)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to start the simulation thread: TickRateHz must be greater than zero."));
+		return;
+	}
+
+	bStopRequested = false;
+	SimulationLoop.OperationContext.Registry = &Registry;
+	SimulationLoop.OperationContext.World = nullptr;
+	SimulationLoop.OperationContext.bHeadless = true;
+	
+	Thread = FRunnableThread::Create(this, TEXT("M2SimulationThread"), 0, TPri_AboveNormal);
+}
+
+void FM2SimulationThread::StopThread()
+{
+	if (!Thread)
+	{
+		return;
+	}
+	
+	Thread->Kill(true);
+	delete Thread;
+	Thread = nullptr;
+}
+
+void FM2SimulationThread::StepSimulation(float DeltaTime)
+{
+	SimulationLoop.OperationContext.Registry = &Registry;
+	SimulationLoop.OperationContext.bHeadless = true;
+	
+	TFunction<void(UM2Registry&)> Command;
+	while (Commands.Dequeue(Command))
+	{
+		Command(Registry);
+	}
+
+	SimulationLoop.RunLoop(DeltaTime);
+
+	for (const TSharedRef<FM2PublishedFieldBase>& PublishedField : PublishedFields)
+	{
+		PublishedField->Capture(Registry);
+	}
+}
+
+void FM2SimulationThread::Publish()
+{
+	for (const TSharedRef<FM2PublishedFieldBase>& PublishedField : PublishedFields)
+	{
+		PublishedField->Publish();
+	}
+}
+
+uint32 FM2SimulationThread::Run()
+{
+	const double StepSeconds = 1.0 / TickRateHz;
+	double NextStepTime = FPlatformTime::Seconds();
+	
+	while (!bStopRequested)
+	{
+		const double Now = FPlatformTime::Seconds();
+		if (Now < NextStepTime)
+		{
+			FPlatformProcess::SleepNoStats(static_cast<float>(NextStepTime - Now));
+			continue;
+		}
+
+		{
+			// The game thread can't collect garbage in the middle of a step, while operations are using the registry.
+			FGCScopeGuard GCGuard;
+			StepSimulation(static_cast<float>(StepSeconds));
+		}
+		NextStepTime += StepSeconds;
+
+		// Don't try to catch up on more than a couple of steps, or one slow step turns into a backlog that never clears.
+		if (FPlatformTime::Seconds() - NextStepTime > StepSeconds * 2.0)
+		{
+			M2_LOG(LogM2, Verbose, TEXT("Simulation thread fell behind. Dropping %.3f seconds."), FPlatformTime::Seconds() - NextStepTime);
+			NextStepTime = FPlatformTime::Seconds();
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,305 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2SpatialIndex.h"
+
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+UM2SpatialIndex* UM2SpatialIndex::CreateInternal(UM2Registry& Registry, UScriptStruct* PositionField, float InCellSize, TFunction<void(UM2RecordSet&, TArray<FVector>&)>&& InGetPositions)
+{
+	if (InCellSize <= 0.0f)
+	{
+		M2_LOG(LogM2, Error, TEXT("Unable to create spatial index for %s: CellSize must be greater than zero."), *GetNameSafe(PositionField));
+		return nullptr;
+	}
+	if (Registry.SpatialIndices.Contains(PositionField))
+	{
+		M2_LOG(LogM2, Warning, TEXT("Spatial index for %s already exists."), *GetNameSafe(PositionField));
+		return Registry.SpatialIndices.FindChecked(PositionField);
+	}
+
+	UM2SpatialIndex* SpatialIndex = NewObject<UM2SpatialIndex>(&Registry);
+	SpatialIndex->CellSize = InCellSize;
+	SpatialIndex->GetPositions = MoveTemp(InGetPositions);
+
+	TArray<UScriptStruct*> Match = {PositionField};
+	TArray<UScriptStruct*> Exclude;
+	for (UM2RecordSet* RecordSet : Registry.GetAll(Match, Exclude))
+	{
+		SpatialIndex->IndexedSets.Add(RecordSet);
+	}
+
+	Registry.SpatialIndices.Add(PositionField, SpatialIndex);
+	SpatialIndex->Update();
+	return SpatialIndex;
+}
+
+FIntVector UM2SpatialIndex::GetCell(const FVector& Position) const
+{
+	return FIntVector(
+		FMath::FloorToInt32(Position.X / CellSize),
+		FMath::FloorToInt32(Position.Y / CellSize),
+		FMath::FloorToInt32(Position.Z / CellSize)
+	);
+}
+
+void UM2SpatialIndex::RemoveFromCell(const FM2RecordHandle& Handle, const FIntVector& Cell)
+{
+	TArray<FM2RecordHandle>* CellHandles = Cells.Find(Cell);
+	if (!CellHandles)
+	{
+		return;
+	}
+	
+	CellHandles->RemoveSingleSwap(Handle, EAllowShrinking::No);
+	if (CellHandles->IsEmpty())
+	{
+		Cells.Remove(Cell);
+	}
+}
+
+void UM2SpatialIndex::Update()
+{
+	Epoch++;
+	NumRebucketed = 0;
+	int32 NumVisited = 0;
+	
+	for (TWeakObjectPtr<UM2RecordSet> WeakRecordSet : IndexedSets)
+	{
+		UM2RecordSet* RecordSet = WeakRecordSet.Get();
+		if (!RecordSet)
+		{
+			continue;
+		}
+		
+		GetPositions(*RecordSet, PositionScratch);
+		TArrayView<FM2RecordHandle> Handles = RecordSet->GetHandles();
+		NumVisited += Handles.Num();
+		
+		for (int32 RecordIndex = 0; RecordIndex < Handles.Num(); ++RecordIndex)
+		{
+			const FM2RecordHandle& Handle = Handles[RecordIndex];
+			const FVector& Position = PositionScratch[RecordIndex];
+			const FIntVector Cell = GetCell(Position);
+
+			FEntry* Entry = Entries.Find(Handle);
+			if (!Entry)
+			{
+				Entry = &Entries.Add(Handle);
+				Entry->Cell = Cell;
+				Cells.FindOrAdd(Cell).Add(Handle);
+				NumRebucketed++;
+			}
+			else if (Entry->Cell != Cell)
+			{
+				RemoveFromCell(Handle, Entry->Cell);
+				Entry->Cell = Cell;
+				Cells.FindOrAdd(Cell).Add(Handle);
+				NumRebucketed++;
+			}
+			
+			Entry->Position = Position;
+			Entry->Epoch = Epoch;
+		}
+	}
+
+	// Only look for removed records if some entries weren't visited.
+	if (Entries.Num() > NumVisited)
+	{
+		for (auto Iterator = Entries.CreateIterator(); Iterator; ++Iterator)
+		{
+			if (Iterator.Value().Epoch != Epoch)
+			{
+				RemoveFromCell(Iterator.Key(), Iterator.Value().Cell);
+				Iterator.RemoveCurrent();
+			}
+		}
+	}
+
+	MinOccupiedCell = FIntVector(MAX_int32);
+	MaxOccupiedCell = FIntVector(MIN_int32);
+	for (const auto& [Cell, CellHandles] : Cells)
+	{
+		MinOccupiedCell = FIntVector(FMath::Min(MinOccupiedCell.X, Cell.X), FMath::Min(MinOccupiedCell.Y, Cell.Y), FMath::Min(MinOccupiedCell.Z, Cell.Z));
+		MaxOccupiedCell = FIntVector(FMath::Max(MaxOccupiedCell.X, Cell.X), FMath::Max(MaxOccupiedCell.Y, Cell.Y), FMath::Max(MaxOccupiedCell.Z, Cell.Z));
+	}
+}
+
+void UM2SpatialIndex::QueryRadius(const FVector& Center, float Radius, TArray<FM2RecordHandle>& OutHandles) const
+{
+	const FIntVector MinCell = GetCell(Center - FVector(Radius));
+	const FIntVector MaxCell = GetCell(Center + FVector(Radius));
+	const double RadiusSquared = FMath::Square(Radius);
+	
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				const TArray<FM2RecordHandle>* CellHandles = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellHandles)
+				{
+					continue;
+				}
+				
+				for (const FM2RecordHandle& Handle : *CellHandles)
+				{
+					if (FVector::DistSquared(Entries.FindChecked(Handle).Position, Center) <= RadiusSquared)
+					{
+						OutHandles.Add(Handle);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UM2SpatialIndex::QueryBox(const FBox& Box, TArray<FM2RecordHandle>& OutHandles) const
+{
+	const FIntVector MinCell = GetCell(Box.Min);
+	const FIntVector MaxCell = GetCell(Box.Max);
+	
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; ++Z)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; ++Y)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; ++X)
+			{
+				const TArray<FM2RecordHandle>* CellHandles = Cells.Find(FIntVector(X, Y, Z));
+				if (!CellHandles)
+				{
+					continue;
+				}
+				
+				for (const FM2RecordHandle& Handle : *CellHandles)
+				{
+					if (Box.IsInsideOrOn(Entries.FindChecked(Handle).Position))
+					{
+						OutHandles.Add(Handle);
+					}
+				}
+			}
+		}
+	}
+}
+
+void UM2SpatialIndex::QueryNearest(const FVector& Point, int32 K, float MaxRadius, TArray<FM2RecordHandle>& OutHandles) const
+{
+	if (K <= 0 || Cells.IsEmpty())
+	{
+		return;
+	}
+	
+	// Search rings of cells around the point, until nothing in the rings that are left could beat the K-th candidate.
+	TArray<TPair<double, FM2RecordHandle>> Candidates;
+	const FIntVector Center = GetCell(Point);
+	const double MaxRadiusSquared = FMath::Square(MaxRadius);
+
+	// Past the ring that reaches every occupied cell there is nothing left to find, however large MaxRadius is.
+	int64 OccupiedRing = 0;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		OccupiedRing = FMath::Max3(OccupiedRing, static_cast<int64>(Center[Axis]) - MinOccupiedCell[Axis], static_cast<int64>(MaxOccupiedCell[Axis]) - Center[Axis]);
+	}
+	const int32 MaxRing = static_cast<int32>(FMath::Min3<double>(FMath::CeilToDouble(MaxRadius / CellSize), static_cast<double>(OccupiedRing), MAX_int32 - 1));
+
+	// How close the point is to the faces of its own cell. Rings grow by a full cell on every side.
+	const FVector CellMin = FVector(Center) * CellSize;
+	const FVector ToMin = Point - CellMin;
+	const FVector ToMax = CellMin + FVector(CellSize) - Point;
+	const double FaceDistance = FMath::Min(ToMin.GetMin(), ToMax.GetMin());
+	
+	for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+	{
+		for (int32 Z = -Ring; Z <= Ring; ++Z)
+		{
+			for (int32 Y = -Ring; Y <= Ring; ++Y)
+			{
+				// Only the shell of the ring, since the inside was covered by the previous rings. Rows on the shell's top,
+				// bottom or sides are visited in full, and the other rows only at their two ends.
+				const bool bFullRow = FMath::Abs(Z) == Ring || FMath::Abs(Y) == Ring;
+				const int32 XStep = bFullRow ? 1 : 2 * Ring;
+				
+				for (int32 X = -Ring; X <= Ring; X += XStep)
+				{
+					const TArray<FM2RecordHandle>* CellHandles = Cells.Find(Center + FIntVector(X, Y, Z));
+					if (!CellHandles)
+					{
+						continue;
+					}
+					
+					for (const FM2RecordHandle& Handle : *CellHandles)
+					{
+						const double DistanceSquared = FVector::DistSquared(Entries.FindChecked(Handle).Position, Point);
+						if (DistanceSquared <= MaxRadiusSquared)
+						{
+							Candidates.Emplace(DistanceSquared, Handle);
+						}
+					}
+				}
+			}
+		}
+
+		// Everything that hasn't been visited yet is at least this far away from the point.
+		const double UnvisitedDistance = FaceDistance + Ring * CellSize;
+		if (UnvisitedDistance >= MaxRadius)
+		{
+			break;
+		}
+		if (Candidates.Num() >= K)
+		{
+			Candidates.Sort([](const TPair<double, FM2RecordHandle>& A, const TPair<double, FM2RecordHandle>& B) { return A.Key < B.Key; });
+			if (Candidates[K - 1].Key <= FMath::Square(UnvisitedDistance))
+			{
+				break;
+			}
+		}
+	}
+
+	Candidates.Sort([](const TPair<double, FM2RecordHandle>& A, const TPair<double, FM2RecordHandle>& B) { return A.Key < B.Key; });
+	for (int32 CandidateIndex = 0; CandidateIndex < FMath::Min(K, Candidates.Num()); ++CandidateIndex)
+	{
+		OutHandles.Add(Candidates[CandidateIndex].Value);
+	}
+}
+
+const FVector* UM2SpatialIndex::GetIndexedPosition(const FM2RecordHandle& Handle) const
+{
+	const FEntry* Entry = Entries.Find(Handle);
+	return Entry ? &Entry->Position : nullptr;
+}
+
+void UM2SpatialIndexUpdateOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	Ctx.Registry->UpdateSpatialIndices();
+}
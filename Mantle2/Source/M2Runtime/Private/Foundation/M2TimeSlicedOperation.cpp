@@ -0,0 +1,163 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Foundation/M2TimeSlicedOperation.h"
+
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+
+void UM2TimeSlicedOperation::Initialize(UM2Registry* Registry)
+{
+	for (TWeakObjectPtr<UM2RecordSet> RecordSet : QuerySets)
+	{
+		if (RecordSet.IsValid())
+		{
+			RecordSet->OnRecordRemoved().RemoveAll(this);
+		}
+	}
+	QuerySets.Empty();
+	
+	TArray<UScriptStruct*> Match;
+	TArray<UScriptStruct*> Exclude;
+	GetQuery(Match, Exclude);
+
+	for (UM2RecordSet* RecordSet : Registry->GetAll(Match, Exclude))
+	{
+		QuerySets.Add(RecordSet);
+		RecordSet->OnRecordRemoved().AddUObject(this, &ThisClass::HandleRecordRemoved, TWeakObjectPtr<UM2RecordSet>(RecordSet));
+	}
+
+	SetCursor = 0;
+	RecordCursor = 0;
+	PendingRecords.Empty();
+}
+
+void UM2TimeSlicedOperation::BeginDestroy()
+{
+	for (TWeakObjectPtr<UM2RecordSet> RecordSet : QuerySets)
+	{
+		if (RecordSet.IsValid())
+		{
+			RecordSet->OnRecordRemoved().RemoveAll(this);
+		}
+	}
+	
+	Super::BeginDestroy();
+}
+
+void UM2TimeSlicedOperation::PerformOperation(FM2OperationContext& Ctx)
+{
+	if (QuerySets.IsEmpty())
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 BatchSize = FMath::Max(TimeCheckInterval, 1);
+	int32 RemainingRecords = RecordBudget == kUnlimitedRecords ? MAX_int32 : RecordBudget;
+
+	auto IsOutOfBudget = [&]()
+	{
+		if (RemainingRecords <= 0)
+		{
+			return true;
+		}
+		return TimeBudgetMicroseconds >= 0.0f && (FPlatformTime::Seconds() - StartTime) * 1000000.0 >= TimeBudgetMicroseconds;
+	};
+
+	// Records that were moved behind the cursor go first, so they are never starved by the rest of the sweep.
+	while (!PendingRecords.IsEmpty() && !IsOutOfBudget())
+	{
+		const FM2RecordHandle RecordHandle = PendingRecords.Pop(EAllowShrinking::No);
+		
+		UM2RecordSet* RecordSet = Ctx.Registry->GetRecordSet(RecordHandle);
+		const int32 RecordIndex = RecordSet ? RecordSet->GetRecordIndex(RecordHandle) : INDEX_NONE;
+		if (RecordIndex != INDEX_NONE)
+		{
+			ProcessRecords(Ctx, *RecordSet, RecordIndex, RecordIndex + 1);
+			RemainingRecords--;
+		}
+	}
+
+	while (SetCursor < QuerySets.Num() && !IsOutOfBudget())
+	{
+		UM2RecordSet* RecordSet = QuerySets[SetCursor].Get();
+		if (!RecordSet || RecordCursor >= RecordSet->Num())
+		{
+			SetCursor++;
+			RecordCursor = 0;
+			continue;
+		}
+
+		const int32 StartIndex = RecordCursor;
+		const int32 EndIndex = FMath::Min3(RecordSet->Num(), StartIndex + BatchSize, StartIndex + RemainingRecords);
+		
+		// Move the cursor first, so the records being processed already count as visited.
+		RecordCursor = EndIndex;
+		RemainingRecords -= EndIndex - StartIndex;
+		
+		ProcessRecords(Ctx, *RecordSet, StartIndex, EndIndex);
+	}
+
+	PostProcessRecords(Ctx);
+
+	if (SetCursor >= QuerySets.Num() && PendingRecords.IsEmpty())
+	{
+		OnSweepFinished(Ctx);
+		SetCursor = 0;
+		RecordCursor = 0;
+	}
+}
+
+void UM2TimeSlicedOperation::ProcessRecords(FM2OperationContext& Ctx, UM2RecordSet& RecordSet, int32 StartIndex, int32 EndIndex)
+{
+	M2_LOG(LogM2, Error, TEXT("ProcessRecords must be overriden."));
+}
+
+void UM2TimeSlicedOperation::HandleRecordRemoved(const FM2RecordHandle& RecordHandle, int32 RecordIndex, TWeakObjectPtr<UM2RecordSet> RecordSet)
+{
+	if (!QuerySets.IsValidIndex(SetCursor) || QuerySets[SetCursor] != RecordSet || !RecordSet.IsValid())
+	{
+		// Sets behind the set cursor have been fully visited, and sets ahead of it haven't been visited at all, so
+		// only the set under the cursor needs fixing up.
+		return;
+	}
+
+	// The set's last record was swapped into RecordIndex. If it came from ahead of the cursor and landed behind it,
+	// it hasn't been visited yet.
+	const int32 MovedFromIndex = RecordSet->Num();
+	if (RecordIndex < RecordCursor && MovedFromIndex >= RecordCursor && RecordIndex < RecordSet->Num())
+	{
+		PendingRecords.Add(RecordSet->GetHandles()[RecordIndex]);
+	}
+
+	RecordCursor = FMath::Min(RecordCursor, RecordSet->Num());
+}
@@ -38,4 +38,12 @@ DEFINE_LOG_CATEGORY(LogM2Test)
 // Counters
 DEFINE_STAT(STAT_M2_EntityCount);
 DEFINE_STAT(STAT_M2_TempararyEntitiesAdded);
-DEFINE_STAT(STAT_M2_TempararyEntitiesRemoved);
\ No newline at end of file
+DEFINE_STAT(STAT_M2_TempararyEntitiesRemoved);
+DEFINE_STAT(STAT_M2_ActiveEffects);
+DEFINE_STAT(STAT_M2_EffectTriggers);
+DEFINE_STAT(STAT_M2_EffectStateTransitions);
+DEFINE_STAT(STAT_M2_EffectRecordsDeleted);
+DEFINE_STAT(STAT_M2_AttributeModifiersApplied);
+DEFINE_STAT(STAT_M2_OperationsDeferred);
+DEFINE_STAT(STAT_M2_EffectManager);
+DEFINE_STAT(STAT_M2_AttributeAggregator);
\ No newline at end of file
@@ -53,3 +53,9 @@ void UM2TestSet_Excluded::Initialize()
 {
 	M2_INITIALIZE_FIELD(FM2TestField_Avatar, Avatar);
 }
+
+void UM2TestSet_Character::Initialize()
+{
+	M2_INITIALIZE_FIELD(FM2TestField_Health, Health);
+	M2_INITIALIZE_FIELD(FM2TestField_Armor, Armor);
+}
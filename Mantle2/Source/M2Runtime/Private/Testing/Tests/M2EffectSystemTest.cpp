@@ -0,0 +1,601 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "EffectSystem/M2AttributeAggregator.h"
+#include "EffectSystem/M2EffectInstance.h"
+#include "EffectSystem/M2EffectManager.h"
+#include "Foundation/M2Registry.h"
+#include "Logging/LogVerbosity.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+#include "Misc/AutomationTest.h"
+#include "Testing/M2TestEffects.h"
+#include "Testing/M2TestRegistry.h"
+#include "Testing/M2TestTables.h"
+#include "Testing/Macros/AnankeTestMacros.h"
+
+#if WITH_EDITOR
+
+class EffectSystemTestSuite
+{
+public:
+	EffectSystemTestSuite(FAutomationTestBase* NewTestFramework): TestFramework(NewTestFramework)
+	{
+		// This constructor is run before each test.
+		M2_LOG(LogM2Test, Log, TEXT("Setting up effect system test suite."));
+
+		TestWorld = TStrongObjectPtr<UWorld>(UWorld::CreateWorld(EWorldType::Game, false));
+		UWorld* World = TestWorld.Get();
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		FURL URL;
+		World->InitializeActorsForPlay(URL);
+		World->BeginPlay();
+
+		Registry = TStrongObjectPtr(NewObject<UM2TestRegistry>());
+		Registry->ConstructRecordSets();
+
+		EffectManager = TStrongObjectPtr(NewObject<UM2EffectManager>());
+		EffectManager->Initialize(Registry.Get());
+
+		AttributeAggregator = TStrongObjectPtr(NewObject<UM2AttributeAggregator>());
+		AttributeAggregator->Initialize(Registry.Get());
+
+		Ctx.Registry = Registry.Get();
+		Ctx.World = World;
+	}
+
+	~EffectSystemTestSuite()
+	{
+		// This destructor is run after each test.
+		EffectManager.Reset();
+		AttributeAggregator.Reset();
+		
+		if (TestWorld.IsValid())
+		{
+			UWorld* WorldPtr = TestWorld.Get();
+			GEngine->DestroyWorldContext(WorldPtr);
+			WorldPtr->DestroyWorld(true);
+
+			Registry.Reset();
+			TestWorld.Reset();
+			
+			WorldPtr->MarkAsGarbage();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+		else
+		{
+			Registry.Reset();
+			TestWorld.Reset();
+		}
+	}
+
+	FM2RecordHandle AddEffect(const FM2EffectMetadata& Metadata)
+	{
+		return Registry->GetRecordSet<UM2EffectInstance>()->AddEffect(Metadata);
+	}
+
+	void RunEffectManager(float DeltaTime)
+	{
+		Ctx.DeltaTime = DeltaTime;
+		EffectManager->Run(Ctx);
+	}
+
+	void FastForward(float DeltaTime)
+	{
+		Ctx.DeltaTime = DeltaTime;
+		EffectManager->FastForward(Ctx);
+	}
+
+	void Test_FastForwardHonorsTriggerLimit()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		FM2RecordHandle Handle = AddEffect(
+			FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTriggerLimit(5)
+		);
+
+		RunEffectManager(0.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 1);
+
+		FastForward(100.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 5);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 5);
+		ANANKE_TEST_FALSE(TestFramework, Registry->GetField<FM2EffectMetadata>(Handle)->HasRemainingTriggers());
+
+		// Triggers fired at 0s through 4s. The rest of the step isn't consumed.
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Registry->GetField<FM2EffectMetadata>(Handle)->GetTotalElapsedTime(), 4.0f));
+
+		// Finished -> Delete -> Removed
+		RunEffectManager(0.0f);
+		RunEffectManager(0.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(Handle));
+	}
+
+	void Test_FastForwardHonorsMaxDuration()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		FM2RecordHandle Handle = AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTimeLimit(3.5f));
+
+		RunEffectManager(0.0f);
+		FastForward(10.0f);
+
+		// One trigger when scheduled, then at 1s, 2s, and 3s.
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 4);
+		
+		// Elapsed time stops at MaxDuration.
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Registry->GetField<FM2EffectMetadata>(Handle)->GetTotalElapsedTime(), 3.5f));
+	}
+
+	void Test_FastForwardBatchedTriggers()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_BatchedCounter>();
+		AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_BatchedCounter::StaticClass(), 1.0f));
+
+		RunEffectManager(0.0f);
+		FastForward(10.5f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 2);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 11);
+
+		// The leftover 0.5s should carry over to the next step.
+		FastForward(0.6f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 12);
+	}
+
+	void Test_FastForwardThreshold()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f));
+
+		RunEffectManager(0.0f);
+		RunEffectManager(5.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 2); // Only one trigger per step by default.
+
+		EffectManager->FastForwardThresholdSec = 1.0f;
+		RunEffectManager(5.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTriggers, 7);
+	}
+
+	void Test_EffectIndices()
+	{
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		FM2RecordHandle TargetA = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle TargetB = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle Instigator = Registry->AddRecord<UM2TestSet_Player>();
+
+		auto MakeEffect = [](TSubclassOf<UM2Effect> EffectClass)
+		{
+			return FM2EffectMetadata::MakeRecurringEffect(EffectClass, 1.0f);
+		};
+		
+		AddEffect(MakeEffect(UM2TestEffect_Counter::StaticClass()).WithTarget(TargetA).WithInstigator(Instigator));
+		AddEffect(MakeEffect(UM2TestEffect_Counter::StaticClass()).WithTarget(TargetA));
+		FM2RecordHandle BatchedOnA = AddEffect(MakeEffect(UM2TestEffect_BatchedCounter::StaticClass()).WithTarget(TargetA));
+		AddEffect(MakeEffect(UM2TestEffect_Counter::StaticClass()).WithTarget(TargetB).WithInstigator(Instigator));
+
+		// Effects added directly are picked up by the manager the first time it runs.
+		FM2RecordHandle DirectlyAdded = Registry->AddRecord<UM2EffectInstance>();
+		*Registry->GetField<FM2EffectMetadata>(DirectlyAdded) = MakeEffect(UM2TestEffect_Counter::StaticClass()).WithTarget(TargetB);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetB), 1);
+		RunEffectManager(0.0f);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetB), 2);
+
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetA), 3);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetA, UM2TestEffect_BatchedCounter::StaticClass()), 1);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsFromInstigator(Instigator), 2);
+
+		TArray<FM2RecordHandle> Effects;
+		EffectInstances->GetEffectsOnTarget(TargetA, Effects, UM2TestEffect_BatchedCounter::StaticClass());
+		if (ANANKE_TEST_EQUAL(TestFramework, Effects.Num(), 1))
+		{
+			ANANKE_TEST_TRUE(TestFramework, Effects[0] == BatchedOnA);
+		}
+
+		Registry->RemoveRecord(BatchedOnA);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetA), 2);
+
+		// Once an effect is indexed, its handles are fixed, so the index can't go stale.
+		FM2EffectMetadata* IndexedMetadata = Registry->GetField<FM2EffectMetadata>(DirectlyAdded);
+		IndexedMetadata->WithTarget(TargetA).WithInstigator(Instigator);
+		ANANKE_TEST_TRUE(TestFramework, IndexedMetadata->GetTarget() == TargetB);
+		ANANKE_TEST_FALSE(TestFramework, IndexedMetadata->GetInstigator().IsSet());
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetA), 2);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetB), 2);
+
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CancelEffectsFromInstigator(Instigator), 2);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetA), 1);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(TargetB), 1);
+	}
+
+	void Test_RemovingTargetCleansUpEffects()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle Instigator = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle InstanceData = Registry->AddRecord<UM2TestSet_Player>();
+
+		FM2RecordHandle EffectOnTarget = AddEffect(
+			FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTarget(Target).WithInstigator(Instigator)
+		);
+		FM2RecordHandle EffectWithData = AddEffect(
+			FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithInstanceData(InstanceData)
+		);
+		RunEffectManager(0.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 2);
+
+		// By default, effects outlive their instigator.
+		Registry->RemoveRecord(Instigator);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_TRUE(TestFramework, Registry->HasRecord(EffectOnTarget));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 4);
+
+		// Removing the target cancels the effect before it gets a chance to tick again.
+		Registry->RemoveRecord(Target);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(EffectOnTarget));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 1);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumDeletes, 1);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 5);
+
+		// Removing the instance data deletes the effect without cancelling it.
+		Registry->RemoveRecord(InstanceData);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(EffectWithData));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 1);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumDeletes, 2);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, 5);
+	}
+
+	void Test_RemovalCallbacksCanAddEffects()
+	{
+		auto* Effect = Registry->GetShared<UM2TestEffect_Retaliate>();
+		Effect->NumRetaliations = 64;
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle Instigator = Registry->AddRecord<UM2TestSet_Player>();
+
+		TArray<FM2RecordHandle> Effects;
+		for (int32 Count = 0; Count < 3; ++Count)
+		{
+			Effects.Add(AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Retaliate::StaticClass(), 1.0f).WithTarget(Target).WithInstigator(Instigator)));
+		}
+		RunEffectManager(0.0f);
+
+		// Each cancellation adds enough effects to grow the effect columns and the target index while they are in use.
+		Registry->RemoveRecord(Target);
+		RunEffectManager(0.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 3);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumDeletes, 3);
+		for (const FM2RecordHandle& EffectHandle : Effects)
+		{
+			ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(EffectHandle));
+		}
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetRecordSet<UM2EffectInstance>()->CountEffectsOnTarget(Instigator), 3 * Effect->NumRetaliations);
+	}
+
+	void Test_MovedRecordsKeepTheirEffects()
+	{
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		Registry->EnableSharding<UM2TestSet_Player>(&FM2TestField_Avatar::WorldPosition, FBox(FVector(0.0f), FVector(200.0f, 100.0f, 100.0f)), 100.0f);
+		
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		Registry->GetField<FM2TestField_Avatar>(Target)->WorldPosition = FVector(150.0f, 50.0f, 50.0f);
+		FM2RecordHandle EffectHandle = AddEffect(
+			FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTarget(Target).WithInstigator(Target)
+		);
+
+		// Migrating the target into its shard changes its handle. The effect follows it.
+		FM2RecordHandle MovedTarget;
+		Registry->OnRecordMoved().AddLambda([&MovedTarget](const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle)
+		{
+			MovedTarget = NewHandle;
+		});
+		ANANKE_TEST_EQUAL(TestFramework, Registry->MigrateShardedRecords(), 1);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(Target), 0);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsOnTarget(MovedTarget), 1);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsFromInstigator(MovedTarget), 1);
+		const FM2EffectMetadata* EffectMetadata = Registry->GetField<FM2EffectMetadata>(EffectHandle);
+		ANANKE_TEST_TRUE(TestFramework, EffectMetadata->GetTarget() == MovedTarget && EffectMetadata->GetInstigator() == MovedTarget);
+
+		// Moving isn't removing, so the effect keeps running.
+		RunEffectManager(1.0f);
+		ANANKE_TEST_TRUE(TestFramework, Registry->HasRecord(EffectHandle));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 0);
+
+		// Removing the target under its new handle still cleans up the effect.
+		Registry->RemoveRecord(MovedTarget);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(EffectHandle));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 1);
+		ANANKE_TEST_FALSE(TestFramework, EffectInstances->IsReferenced(MovedTarget));
+	}
+
+	void Test_UnloadedEffectsAreRestored()
+	{
+		const FName CellName(TEXT("TestCell"));
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		auto* Effect = Registry->GetShared<UM2TestEffect_Counter>();
+		
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle EffectHandle = AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTarget(Target));
+		Registry->AssignRecordToCell(Target, CellName);
+		Registry->AssignRecordToCell(EffectHandle, CellName);
+		RunEffectManager(0.0f);
+
+		// Unloaded effects leave the indices and stop ticking.
+		ANANKE_TEST_EQUAL(TestFramework, Registry->UnloadCell(CellName), 2);
+		ANANKE_TEST_FALSE(TestFramework, EffectInstances->IsReferenced(Target));
+		const int32 NumTickCalls = Effect->NumTickCalls;
+		RunEffectManager(1.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumTickCalls, NumTickCalls);
+
+		// Loading puts them back in the indices, under the same handles.
+		ANANKE_TEST_EQUAL(TestFramework, Registry->LoadCell(CellName), 2);
+		TArray<FM2RecordHandle> EffectsOnTarget;
+		EffectInstances->GetEffectsOnTarget(Target, EffectsOnTarget);
+		ANANKE_TEST_TRUE(TestFramework, EffectsOnTarget == TArray<FM2RecordHandle>({EffectHandle}));
+
+		// So removing the target cleans up the restored effect like any other.
+		Registry->RemoveRecord(Target);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(EffectHandle));
+		ANANKE_TEST_EQUAL(TestFramework, Effect->NumCancels, 1);
+	}
+
+	void Test_AddStack()
+	{
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle InstigatorA = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle InstigatorB = Registry->AddRecord<UM2TestSet_Player>();
+
+		FM2EffectMetadata Metadata = FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_AddStack::StaticClass(), 1.0f).WithTarget(Target);
+		FM2RecordHandle FirstHandle = AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorA));
+		for (int32 Count = 0; Count < 4; ++Count)
+		{
+			ANANKE_TEST_TRUE(TestFramework, AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorA)) == FirstHandle);
+		}
+		FM2RecordHandle OtherHandle = AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorB));
+		
+		ANANKE_TEST_FALSE(TestFramework, OtherHandle == FirstHandle);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->Num(), 2);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2EffectMetadata>(FirstHandle)->GetStackCount(), 3);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2EffectMetadata>(OtherHandle)->GetStackCount(), 1);
+
+		// Directly added records are merged the first time the manager runs.
+		FM2RecordHandle DirectlyAdded = Registry->AddRecord<UM2EffectInstance>();
+		*Registry->GetField<FM2EffectMetadata>(DirectlyAdded) = FM2EffectMetadata(Metadata).WithInstigator(InstigatorB);
+		RunEffectManager(0.0f);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(DirectlyAdded));
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2EffectMetadata>(OtherHandle)->GetStackCount(), 2);
+
+		// Stacking also restarts the trigger limit, so a refreshed effect gets its full number of triggers again.
+		FM2RecordHandle LimitedTarget = Registry->AddRecord<UM2TestSet_Player>();
+		FM2EffectMetadata LimitedMetadata = FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_AddStack::StaticClass(), 1.0f).WithTarget(LimitedTarget).WithTriggerLimit(3);
+		FM2RecordHandle LimitedHandle = AddEffect(LimitedMetadata);
+		RunEffectManager(0.0f);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_TRUE(TestFramework, AddEffect(LimitedMetadata) == LimitedHandle);
+		RunEffectManager(1.0f);
+		RunEffectManager(1.0f);
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetField<FM2EffectMetadata>(LimitedHandle)->IsActive());
+	}
+
+	void Test_KeepStrongest()
+	{
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle InstigatorA = Registry->AddRecord<UM2TestSet_Player>();
+		FM2RecordHandle InstigatorB = Registry->AddRecord<UM2TestSet_Player>();
+
+		FM2EffectMetadata Metadata = FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_KeepStrongest::StaticClass(), 1.0f).WithTarget(Target);
+		FM2RecordHandle Handle = AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorA).WithMagnitude(2.0f));
+		AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorB).WithMagnitude(1.0f));
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2EffectMetadata>(Handle)->GetMagnitude(), 2.0f);
+		
+		AddEffect(FM2EffectMetadata(Metadata).WithInstigator(InstigatorB).WithMagnitude(5.0f));
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2EffectMetadata>(Handle)->GetMagnitude(), 5.0f);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->Num(), 1);
+
+		// The stronger application's instigator takes over, including in the index.
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetField<FM2EffectMetadata>(Handle)->GetInstigator() == InstigatorB);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsFromInstigator(InstigatorA), 0);
+		ANANKE_TEST_EQUAL(TestFramework, EffectInstances->CountEffectsFromInstigator(InstigatorB), 1);
+	}
+
+	void Test_InlinePayload()
+	{
+		UM2EffectInstance* EffectInstances = Registry->GetRecordSet<UM2EffectInstance>();
+		FM2RecordHandle Target = Registry->AddRecord<UM2TestSet_Player>();
+
+		FM2TestEffectPayload InitialPayload;
+		InitialPayload.Count = 10;
+		
+		FM2EffectMetadata Metadata = FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Payload::StaticClass(), 1.0f).WithTarget(Target);
+		FM2RecordHandle Handle = EffectInstances->AddEffect(Metadata, InitialPayload);
+		FM2RecordHandle NoPayloadHandle = AddEffect(Metadata);
+
+		RunEffectManager(0.0f);
+		RunEffectManager(1.0f);
+		RunEffectManager(1.0f);
+
+		FInstancedStruct* Payload = EffectInstances->GetPayload(Handle);
+		ANANKE_TEST_TRUE(TestFramework, Payload && Payload->GetPtr<FM2TestEffectPayload>());
+		ANANKE_TEST_EQUAL(TestFramework, Payload->Get<FM2TestEffectPayload>().Count, 13);
+
+		// Effects without a payload see an empty struct, so the test effect cancels itself.
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(NoPayloadHandle));
+	}
+
+	void Test_AttributeModifiers()
+	{
+		UM2AttributeModifierBuffer* Buffer = Registry->GetShared<UM2AttributeModifierBuffer>();
+		FM2RecordHandle CharacterA = Registry->AddRecord<UM2TestSet_Character>();
+		FM2RecordHandle CharacterB = Registry->AddRecord<UM2TestSet_Character>();
+		FM2RecordHandle Removed = Registry->AddRecord<UM2TestSet_Character>();
+		Registry->GetField<FM2TestField_Health>(CharacterA)->Value = 100.0f;
+		Registry->GetField<FM2TestField_Health>(CharacterB)->Value = 100.0f;
+		Registry->GetField<FM2TestField_Armor>(CharacterB)->Value = 10.0f;
+
+		// Emitted out of order on purpose: multiplies always apply after adds.
+		Buffer->AddModifier<FM2TestField_Health>(CharacterA, EM2AttributeModifierOp::Multiply, 2.0f);
+		Buffer->AddModifier<FM2TestField_Health>(CharacterA, EM2AttributeModifierOp::Add, 10.0f);
+		Buffer->AddModifier<FM2TestField_Health>(CharacterA, EM2AttributeModifierOp::Add, -5.0f);
+		Buffer->AddModifier<FM2TestField_Health>(CharacterB, EM2AttributeModifierOp::Add, 10.0f);
+		Buffer->AddModifier<FM2TestField_Health>(CharacterB, EM2AttributeModifierOp::Override, 50.0f);
+		Buffer->AddModifier<FM2TestField_Health>(CharacterB, EM2AttributeModifierOp::Override, 20.0f);
+		Buffer->AddModifier<FM2TestField_Armor>(CharacterB, EM2AttributeModifierOp::Multiply, 0.5f);
+		Buffer->AddModifier<FM2TestField_Health>(Removed, EM2AttributeModifierOp::Add, 1.0f);
+		Registry->RemoveRecord(Removed);
+
+		Ctx.DeltaTime = 0.0f;
+		AttributeAggregator->Run(Ctx);
+
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2TestField_Health>(CharacterA)->Value, 210.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2TestField_Health>(CharacterB)->Value, 50.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2TestField_Armor>(CharacterB)->Value, 5.0f);
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetModifiers().Num(), 0);
+
+		// Modifiers for a field the record doesn't have are dropped, with a single warning however often they come in.
+		TestFramework->AddExpectedMessage(TEXT("has no attribute field"), ELogVerbosity::Warning, EAutomationExpectedMessageFlags::Contains, 1, false);
+		FM2RecordHandle Player = Registry->AddRecord<UM2TestSet_Player>();
+		for (int32 Run = 0; Run < 2; ++Run)
+		{
+			Buffer->AddModifier<FM2TestField_Health>(Player, EM2AttributeModifierOp::Add, 1.0f);
+			AttributeAggregator->Run(Ctx);
+			ANANKE_TEST_EQUAL(TestFramework, Buffer->GetModifiers().Num(), 0);
+		}
+	}
+
+	void Test_EffectsEmitModifiers()
+	{
+		FM2RecordHandle Character = Registry->AddRecord<UM2TestSet_Character>();
+		Registry->GetField<FM2TestField_Health>(Character)->Value = 100.0f;
+
+		FM2EffectMetadata Metadata = FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Damage::StaticClass(), 1.0f).WithTarget(Character);
+		AddEffect(FM2EffectMetadata(Metadata).WithMagnitude(3.0f));
+		AddEffect(FM2EffectMetadata(Metadata).WithMagnitude(7.0f));
+
+		RunEffectManager(0.0f);
+		AttributeAggregator->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2TestField_Health>(Character)->Value, 90.0f);
+
+		RunEffectManager(1.0f);
+		AttributeAggregator->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Registry->GetField<FM2TestField_Health>(Character)->Value, 80.0f);
+	}
+
+	// IMPORTANT! Be sure to register your fn inside your AutomationTest class below!
+
+private:
+	FAutomationTestBase* TestFramework;
+	
+	// Test objects
+	TStrongObjectPtr<UWorld> TestWorld;
+	TStrongObjectPtr<UM2TestRegistry> Registry;
+	TStrongObjectPtr<UM2EffectManager> EffectManager;
+	TStrongObjectPtr<UM2AttributeAggregator> AttributeAggregator;
+
+	FM2OperationContext Ctx;
+};
+
+#define REGISTER_TEST_SUITE_FN(TargetTestName) Tests.Add(TEXT(#TargetTestName), &EffectSystemTestSuite::TargetTestName)
+
+class FEffectSystemTests: public FAutomationTestBase
+{
+public:
+	typedef void (EffectSystemTestSuite::*TestFunction)();
+	
+	FEffectSystemTests(const FString& TestName): FAutomationTestBase(TestName, false)
+	{
+		REGISTER_TEST_SUITE_FN(Test_FastForwardHonorsTriggerLimit);
+		REGISTER_TEST_SUITE_FN(Test_FastForwardHonorsMaxDuration);
+		REGISTER_TEST_SUITE_FN(Test_FastForwardBatchedTriggers);
+		REGISTER_TEST_SUITE_FN(Test_FastForwardThreshold);
+		REGISTER_TEST_SUITE_FN(Test_EffectIndices);
+		REGISTER_TEST_SUITE_FN(Test_RemovingTargetCleansUpEffects);
+		REGISTER_TEST_SUITE_FN(Test_RemovalCallbacksCanAddEffects);
+		REGISTER_TEST_SUITE_FN(Test_MovedRecordsKeepTheirEffects);
+		REGISTER_TEST_SUITE_FN(Test_UnloadedEffectsAreRestored);
+		REGISTER_TEST_SUITE_FN(Test_AddStack);
+		REGISTER_TEST_SUITE_FN(Test_KeepStrongest);
+		REGISTER_TEST_SUITE_FN(Test_InlinePayload);
+		REGISTER_TEST_SUITE_FN(Test_AttributeModifiers);
+		REGISTER_TEST_SUITE_FN(Test_EffectsEmitModifiers);
+	}
+	
+	virtual EAutomationTestFlags GetTestFlags() const override
+	{
+		return EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter;
+	}
+	virtual bool IsStressTest() const { return false; }
+	virtual uint32 GetRequiredDeviceNum() const override { return 1; }
+
+protected:
+	virtual FString GetBeautifiedTestName() const override
+	{
+		return "Mantle2.Runtime.EffectSystemTests";
+	}
+	virtual void GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override
+	{
+		TArray<FString> TargetTestNames;
+		Tests.GetKeys(TargetTestNames);
+		for (const FString& TargetTestName : TargetTestNames)
+		{
+			OutBeautifiedNames.Add(TargetTestName);
+			OutTestCommands.Add(TargetTestName);
+		}
+	}
+	virtual bool RunTest(const FString& Parameters) override
+	{
+		TestFunction* CurrentTest = Tests.Find(Parameters);
+		if (!CurrentTest || !*CurrentTest)
+		{
+			M2_LOG(LogM2Test, Error, TEXT("Cannot find test: %s"), *Parameters);
+			return false;
+		}
+
+		EffectSystemTestSuite Suite(this);
+		(Suite.**CurrentTest)(); // Run the current test from the test suite.
+
+		return true;
+	}
+
+	TMap<FString, TestFunction> Tests;
+};
+
+namespace
+{
+	FEffectSystemTests FEffectSystemTestsInstance(TEXT("FEffectSystemTests"));
+}
+
+#endif //WITH_EDITOR
@@ -0,0 +1,271 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Foundation/M2Engine.h"
+#include "GameFramework/Actor.h"
+#include "Logging/LogVerbosity.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+#include "Misc/AutomationTest.h"
+#include "Testing/M2TestOperations.h"
+#include "Testing/Macros/AnankeTestMacros.h"
+
+#if WITH_EDITOR
+
+class EngineTestSuite
+{
+public:
+	EngineTestSuite(FAutomationTestBase* NewTestFramework): TestFramework(NewTestFramework)
+	{
+		// This constructor is run before each test.
+		M2_LOG(LogM2Test, Log, TEXT("Setting up engine test suite."));
+
+		TestWorld = TStrongObjectPtr<UWorld>(UWorld::CreateWorld(EWorldType::Game, false));
+		UWorld* World = TestWorld.Get();
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		FURL URL;
+		World->InitializeActorsForPlay(URL);
+		World->BeginPlay();
+
+		Engine = TStrongObjectPtr(NewObject<UM2Engine>());
+	}
+
+	~EngineTestSuite()
+	{
+		// This destructor is run after each test.
+		if (TestWorld.IsValid())
+		{
+			UWorld* WorldPtr = TestWorld.Get();
+			GEngine->DestroyWorldContext(WorldPtr);
+			WorldPtr->DestroyWorld(true);
+
+			Engine.Reset();
+			TestWorld.Reset();
+			
+			WorldPtr->MarkAsGarbage();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+		else
+		{
+			Engine.Reset();
+			TestWorld.Reset();
+		}
+	}
+
+	void Test_PhaseOrder()
+	{
+		const FName Camera(TEXT("Camera"));
+		const UM2TestOperation_Recorder* CameraOp = AddPhase(Camera, TG_PrePhysics, {TEXT("TG_PostPhysics")});
+		const UM2TestOperation_Recorder* PostPhysicsOp = AddPhase(TEXT("TG_PostPhysics"), TG_PostPhysics);
+		const UM2TestOperation_Recorder* PrePhysicsOp = AddPhase(TEXT("TG_PrePhysics"), TG_PrePhysics);
+		Engine->FinishConfiguration();
+
+		// A phase that starts in an earlier tick group is pushed back behind the phases it runs after.
+		Engine->Step(0.1f, 2);
+		const TArray<FName> Expected = {PrePhysicsOp->GetFName(), PostPhysicsOp->GetFName(), CameraOp->GetFName()};
+		ANANKE_TEST_TRUE(TestFramework, RunOrder == TArray<FName>({Expected[0], Expected[1], Expected[2], Expected[0], Expected[1], Expected[2]}));
+
+		FM2EngineLoop* CameraLoop = Engine->GetEngineLoop(Camera);
+		if (!ANANKE_TEST_TRUE(TestFramework, CameraLoop != nullptr))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, HasPrerequisite(*CameraLoop, *Engine->GetEngineLoop(TG_PostPhysics)));
+
+		// Phases and loops can't be changed once the engine has been configured.
+		TestFramework->AddExpectedMessage(TEXT("Engine has already been configured"), ELogVerbosity::Warning, EAutomationExpectedMessageFlags::Contains, 2, false);
+		AddPhase(Camera, TG_PrePhysics);
+		FM2EngineLoopOptions Options;
+		Options.OperationGroups.AddDefaulted();
+		Engine->ConfigureEngineLoop(TG_PrePhysics, Options);
+		ANANKE_TEST_EQUAL(TestFramework, CameraLoop->Options.OperationGroups.Num(), 1);
+		ANANKE_TEST_EQUAL(TestFramework, Engine->GetEngineLoop(TG_PrePhysics)->Options.OperationGroups.Num(), 1);
+	}
+
+	void Test_RunBefore()
+	{
+		const FName Movement(TEXT("Movement"));
+		const UM2TestOperation_Recorder* PostPhysicsOp = AddPhase(TEXT("TG_PostPhysics"), TG_PostPhysics);
+		const UM2TestOperation_Recorder* MovementOp = AddPhase(Movement, TG_PostPhysics, {}, {TEXT("TG_PostPhysics")});
+		Engine->FinishConfiguration();
+
+		// RunBefore is turned into a RunAfter on the other phase.
+		FM2EngineLoop* PostPhysicsLoop = Engine->GetEngineLoop(TG_PostPhysics);
+		FM2EngineLoop* MovementLoop = Engine->GetEngineLoop(Movement);
+		ANANKE_TEST_TRUE(TestFramework, PostPhysicsLoop->RunAfterPhases.Contains(Movement));
+		ANANKE_TEST_EQUAL(TestFramework, MovementLoop->RunBeforePhases.Num(), 0);
+		ANANKE_TEST_TRUE(TestFramework, HasPrerequisite(*PostPhysicsLoop, *MovementLoop));
+		ANANKE_TEST_FALSE(TestFramework, HasPrerequisite(*MovementLoop, *PostPhysicsLoop));
+
+		Engine->Step(0.1f);
+		ANANKE_TEST_TRUE(TestFramework, RunOrder == TArray<FName>({MovementOp->GetFName(), PostPhysicsOp->GetFName()}));
+	}
+
+	void Test_PhaseCycles()
+	{
+		const FName First(TEXT("First"));
+		const FName Second(TEXT("Second"));
+		const FName Self(TEXT("Self"));
+		AddPhase(First, TG_PrePhysics, {Second});
+		AddPhase(Second, TG_PrePhysics, {First});
+		AddPhase(Self, TG_PrePhysics, {}, {Self});
+
+		// Self edges count as cycles too, not as unknown phases.
+		TestFramework->AddExpectedMessage(TEXT("circular prerequisites"), ELogVerbosity::Error, EAutomationExpectedMessageFlags::Contains, 2, false);
+		Engine->FinishConfiguration();
+
+		FM2EngineLoop* SelfLoop = Engine->GetEngineLoop(Self);
+		ANANKE_TEST_FALSE(TestFramework, HasPrerequisite(*SelfLoop, *SelfLoop));
+
+		// Phases in a cycle still run, in tick group order.
+		Engine->Step(0.1f);
+		ANANKE_TEST_EQUAL(TestFramework, RunOrder.Num(), 3);
+	}
+
+	void Test_PhasePrerequisites()
+	{
+		const FName Camera(TEXT("Camera"));
+		AddPhase(Camera, TG_PostPhysics);
+		Engine->FinishConfiguration();
+		FM2EngineLoop* CameraLoop = Engine->GetEngineLoop(Camera);
+
+		AActor* Character = TestWorld->SpawnActor<AActor>();
+		AActor* CameraManager = TestWorld->SpawnActor<AActor>();
+		Character->PrimaryActorTick.bCanEverTick = true;
+		CameraManager->PrimaryActorTick.bCanEverTick = true;
+		Engine->AddPhasePrerequisite(Camera, Character, Character->PrimaryActorTick);
+		Engine->AddPhaseDependent(Camera, CameraManager->PrimaryActorTick);
+		ANANKE_TEST_TRUE(TestFramework, HasPrerequisite(*CameraLoop, Character->PrimaryActorTick));
+		ANANKE_TEST_TRUE(TestFramework, HasPrerequisite(CameraManager->PrimaryActorTick, *CameraLoop));
+
+		TestFramework->AddExpectedMessage(TEXT("Unknown phase"), ELogVerbosity::Error, EAutomationExpectedMessageFlags::Contains, 2, false);
+		Engine->AddPhasePrerequisite(TEXT("Unknown"), Character, Character->PrimaryActorTick);
+		Engine->AddPhaseDependent(TEXT("Unknown"), CameraManager->PrimaryActorTick);
+		ANANKE_TEST_EQUAL(TestFramework, CameraLoop->GetPrerequisites().Num(), 1);
+	}
+
+	// IMPORTANT! Be sure to register your fn inside your AutomationTest class below!
+
+private:
+	// Configures a phase with a single operation, which adds itself to RunOrder whenever it runs.
+	UM2TestOperation_Recorder* AddPhase(const FName PhaseName, const ETickingGroup TickGroup, const TArray<FName>& RunAfter = {}, const TArray<FName>& RunBefore = {})
+	{
+		UM2TestOperation_Recorder* Recorder = NewObject<UM2TestOperation_Recorder>(Engine.Get());
+		Recorder->RunOrder = &RunOrder;
+
+		FM2EnginePhaseOptions PhaseOptions;
+		PhaseOptions.TickGroup = TickGroup;
+		PhaseOptions.RunAfter = RunAfter;
+		PhaseOptions.RunBefore = RunBefore;
+		FM2EngineLoopOptions Options;
+		Options.OperationGroups.AddDefaulted_GetRef().Operations.Add(Recorder);
+		Engine->ConfigureEnginePhase(PhaseName, PhaseOptions, Options);
+		return Recorder;
+	}
+
+	static bool HasPrerequisite(FTickFunction& TickFunction, FTickFunction& Prerequisite)
+	{
+		return TickFunction.GetPrerequisites().ContainsByPredicate([&Prerequisite](const FTickPrerequisite& Entry) { return Entry.PrerequisiteTickFunction == &Prerequisite; });
+	}
+	
+	FAutomationTestBase* TestFramework;
+	
+	// Test objects
+	TStrongObjectPtr<UWorld> TestWorld;
+	TStrongObjectPtr<UM2Engine> Engine;
+
+	TArray<FName> RunOrder;
+};
+
+#define REGISTER_TEST_SUITE_FN(TargetTestName) Tests.Add(TEXT(#TargetTestName), &EngineTestSuite::TargetTestName)
+
+class FEngineTests: public FAutomationTestBase
+{
+public:
+	typedef void (EngineTestSuite::*TestFunction)();
+	
+	FEngineTests(const FString& TestName): FAutomationTestBase(TestName, false)
+	{
+		REGISTER_TEST_SUITE_FN(Test_PhaseOrder);
+		REGISTER_TEST_SUITE_FN(Test_RunBefore);
+		REGISTER_TEST_SUITE_FN(Test_PhaseCycles);
+		REGISTER_TEST_SUITE_FN(Test_PhasePrerequisites);
+	}
+	
+	virtual EAutomationTestFlags GetTestFlags() const override
+	{
+		return EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter;
+	}
+	virtual bool IsStressTest() const { return false; }
+	virtual uint32 GetRequiredDeviceNum() const override { return 1; }
+
+protected:
+	virtual FString GetBeautifiedTestName() const override
+	{
+		return "Mantle2.Runtime.EngineTests";
+	}
+	virtual void GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override
+	{
+		TArray<FString> TargetTestNames;
+		Tests.GetKeys(TargetTestNames);
+		for (const FString& TargetTestName : TargetTestNames)
+		{
+			OutBeautifiedNames.Add(TargetTestName);
+			OutTestCommands.Add(TargetTestName);
+		}
+	}
+	virtual bool RunTest(const FString& Parameters) override
+	{
+		TestFunction* CurrentTest = Tests.Find(Parameters);
+		if (!CurrentTest || !*CurrentTest)
+		{
+			M2_LOG(LogM2Test, Error, TEXT("Cannot find test: %s"), *Parameters);
+			return false;
+		}
+
+		EngineTestSuite Suite(this);
+		(Suite.**CurrentTest)(); // Run the current test from the test suite.
+
+		return true;
+	}
+
+	TMap<FString, TestFunction> Tests;
+};
+
+namespace
+{
+	FEngineTests FEngineTestsInstance(TEXT("FEngineTests"));
+}
+
+#endif //WITH_EDITOR
@@ -0,0 +1,730 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "Containers/Array.h"
+#include "Containers/UnrealString.h"
+#include "Foundation/M2Broadphase.h"
+#include "Foundation/M2ChunkScheduler.h"
+#include "Foundation/M2Engine.h"
+#include "Foundation/M2Registry.h"
+#include "Foundation/M2SimulationInstance.h"
+#include "Foundation/M2SimulationThread.h"
+#include "Logging/LogVerbosity.h"
+#include "Logging/M2LoggingDefs.h"
+#include "Logging/M2LoggingMacros.h"
+#include "Misc/AutomationTest.h"
+#include "Testing/M2TestOperations.h"
+#include "Testing/M2TestRegistry.h"
+#include "Testing/M2TestTables.h"
+#include "Testing/Macros/AnankeTestMacros.h"
+
+#if WITH_EDITOR
+
+class OperationTestSuite
+{
+public:
+	OperationTestSuite(FAutomationTestBase* NewTestFramework): TestFramework(NewTestFramework)
+	{
+		// This constructor is run before each test.
+		M2_LOG(LogM2Test, Log, TEXT("Setting up operation test suite."));
+
+		TestWorld = TStrongObjectPtr<UWorld>(UWorld::CreateWorld(EWorldType::Game, false));
+		UWorld* World = TestWorld.Get();
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+		FURL URL;
+		World->InitializeActorsForPlay(URL);
+		World->BeginPlay();
+
+		Registry = TStrongObjectPtr(NewObject<UM2TestRegistry>());
+		Registry->ConstructRecordSets();
+
+		Ctx.Registry = Registry.Get();
+		Ctx.World = World;
+	}
+
+	~OperationTestSuite()
+	{
+		// This destructor is run after each test.
+		if (TestWorld.IsValid())
+		{
+			UWorld* WorldPtr = TestWorld.Get();
+			GEngine->DestroyWorldContext(WorldPtr);
+			WorldPtr->DestroyWorld(true);
+
+			Registry.Reset();
+			TestWorld.Reset();
+			
+			WorldPtr->MarkAsGarbage();
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		}
+		else
+		{
+			Registry.Reset();
+			TestWorld.Reset();
+		}
+	}
+
+	void Test_TickInterval()
+	{
+		UM2Operation* Operation = NewObject<UM2Operation>();
+		Operation->TickIntervalFrames = 3;
+		Operation->PhaseOffset = 1;
+		Operation->ResetTickInterval();
+
+		TArray<int32> RunIterations;
+		TArray<float> RunDeltaTimes;
+		for (int32 Iteration = 0; Iteration < 7; ++Iteration)
+		{
+			float DeltaTime = 0.0f;
+			if (Operation->ConsumeTickInterval(0.1f, DeltaTime))
+			{
+				RunIterations.Add(Iteration);
+				RunDeltaTimes.Add(DeltaTime);
+			}
+		}
+
+		if (!ANANKE_TEST_EQUAL(TestFramework, RunIterations.Num(), 2))
+		{
+			return;
+		}
+		ANANKE_TEST_EQUAL(TestFramework, RunIterations[0], 1);
+		ANANKE_TEST_EQUAL(TestFramework, RunIterations[1], 4);
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(RunDeltaTimes[0], 0.2f));
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(RunDeltaTimes[1], 0.3f));
+	}
+
+	void Test_FixedTimestep()
+	{
+		TStrongObjectPtr<UM2SimulationInstance> Instance(NewObject<UM2SimulationInstance>());
+		Instance->Initialize(UM2TestRegistry::StaticClass());
+		TWeakObjectPtr<UM2TestOperation_Recorder> Recorder = Instance->NewOperation<UM2TestOperation_Recorder>();
+
+		FM2EngineLoopOptions Options;
+		Options.bUseFixedTimestep = true;
+		Options.FixedTimestep = 0.1f;
+		Options.MaxSubsteps = 2;
+		Options.OperationGroups.AddDefaulted_GetRef().Operations.Add(Recorder);
+		Instance->ConfigureLoop(Options);
+		Instance->FinishConfiguration();
+
+		// Every step gets exactly FixedTimestep, and the leftover time is carried over to the next frame.
+		Instance->Step(0.25f);
+		if (!ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 2))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Recorder->DeltaTimes[0], 0.1f));
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Recorder->DeltaTimes[1], 0.1f));
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Recorder->InterpolationAlphas[1], 0.5f, 1.e-3f));
+
+		Instance->Step(0.06f);
+		if (!ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 3))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Recorder->InterpolationAlphas[2], 0.1f, 1.e-3f));
+
+		// Frames too short for a step don't run the operations at all.
+		Instance->Step(0.05f);
+		ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 3);
+
+		// A long frame is clamped to MaxSubsteps, and only the remainder of a step survives. The rest is dropped rather
+		// than being made up for over the next frames.
+		Instance->Step(0.58f);
+		if (!ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 5))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Recorder->InterpolationAlphas[4], 0.4f, 1.e-3f));
+
+		Instance->Step(0.05f);
+		ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 5);
+		Instance->Step(0.02f);
+		ANANKE_TEST_EQUAL(TestFramework, Recorder->DeltaTimes.Num(), 6);
+	}
+
+	void Test_Step()
+	{
+		TStrongObjectPtr<UM2Engine> Engine(NewObject<UM2Engine>());
+		TWeakObjectPtr<UM2TestOperation_Recorder> Late = Engine->NewOperation<UM2TestOperation_Recorder>();
+		TWeakObjectPtr<UM2TestOperation_Recorder> Early = Engine->NewOperation<UM2TestOperation_Recorder>();
+		TWeakObjectPtr<UM2TestOperation_Recorder> Throttled = Engine->NewOperation<UM2TestOperation_Recorder>();
+		Throttled->TickIntervalFrames = 2;
+		Throttled->PhaseOffset = 0;
+
+		TArray<FName> RunOrder;
+		for (UM2TestOperation_Recorder* Recorder : {Late.Get(), Early.Get(), Throttled.Get()})
+		{
+			Recorder->RunOrder = &RunOrder;
+		}
+
+		// Configured out of order on purpose. Step still runs the loops in tick group order.
+		FM2EngineLoopOptions LateOptions;
+		LateOptions.OperationGroups.AddDefaulted_GetRef().Operations.Add(Late);
+		Engine->ConfigureEngineLoop(TG_PostPhysics, LateOptions);
+		FM2EngineLoopOptions EarlyOptions;
+		EarlyOptions.OperationGroups.AddDefaulted_GetRef().Operations.Add(Early);
+		EarlyOptions.OperationGroups.AddDefaulted_GetRef().Operations.Add(Throttled);
+		Engine->ConfigureEngineLoop(TG_PrePhysics, EarlyOptions);
+
+		// Nothing runs until the engine has been configured.
+		TestFramework->AddExpectedMessage(TEXT("FinishConfiguration has not been called"), ELogVerbosity::Error, EAutomationExpectedMessageFlags::Contains, 1, false);
+		Engine->Step(0.1f);
+		ANANKE_TEST_EQUAL(TestFramework, RunOrder.Num(), 0);
+
+		Engine->FinishConfiguration();
+		Engine->Step(0.1f, 4);
+
+		const FName E = Early->GetFName();
+		const FName T = Throttled->GetFName();
+		const FName L = Late->GetFName();
+		ANANKE_TEST_TRUE(TestFramework, RunOrder == TArray<FName>({E, T, L, E, L, E, T, L, E, L}));
+		ANANKE_TEST_TRUE(TestFramework, Early->DeltaTimes == TArray<float>({0.1f, 0.1f, 0.1f, 0.1f}));
+		ANANKE_TEST_EQUAL(TestFramework, Late->DeltaTimes.Num(), 4);
+		if (ANANKE_TEST_EQUAL(TestFramework, Throttled->DeltaTimes.Num(), 2))
+		{
+			ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Throttled->DeltaTimes[1], 0.2f));
+		}
+
+		// Outside of headless loops, operations still need a world.
+		FM2OperationContext WorldlessCtx;
+		WorldlessCtx.Registry = Registry.Get();
+		Early->Run(WorldlessCtx);
+		ANANKE_TEST_EQUAL(TestFramework, Early->DeltaTimes.Num(), 4);
+	}
+
+	void Test_RunOnAnyThread()
+	{
+		FM2EngineLoop EngineLoop;
+		
+		FM2EngineLoopOptions Options;
+		Options.bRunOnAnyThread = true;
+		Options.OperationGroups.AddDefaulted_GetRef().Operations.Add(NewObject<UM2TestKernel_Offset>());
+		EngineLoop.ApplyOptions(Options);
+		ANANKE_TEST_TRUE(TestFramework, EngineLoop.Options.bRunOnAnyThread);
+		ANANKE_TEST_TRUE(TestFramework, EngineLoop.bRunOnAnyThread);
+
+		// A single operation that isn't thread safe keeps the whole loop on the game thread, even when it is added by a
+		// later call that asks for the loop to run on any thread too.
+		TestFramework->AddExpectedMessage(TEXT("is not thread safe"), ELogVerbosity::Error, EAutomationExpectedMessageFlags::Contains, 1, false);
+		FM2EngineLoopOptions MoreOptions;
+		MoreOptions.bRunOnAnyThread = true;
+		MoreOptions.OperationGroups.AddDefaulted_GetRef().Operations.Add(NewObject<UM2TestOperation_Recorder>());
+		EngineLoop.ApplyOptions(MoreOptions);
+		ANANKE_TEST_FALSE(TestFramework, EngineLoop.Options.bRunOnAnyThread);
+		ANANKE_TEST_FALSE(TestFramework, EngineLoop.bRunOnAnyThread);
+		ANANKE_TEST_EQUAL(TestFramework, EngineLoop.Options.OperationGroups.Num(), 2);
+	}
+
+	void Test_FrameBudgetDeferral()
+	{
+		UM2Operation* Operation = NewObject<UM2TestOperation_Sweep>();
+		Operation->bDeferrable = true;
+		Operation->Priority = EM2OperationPriority::Low;
+		Operation->RecordCost(2.0);
+
+		// Low priority operations are deferred if they are predicted to go over the budget.
+		ANANKE_TEST_FALSE(TestFramework, Operation->ShouldDefer(7.0, 10.0, 2));
+		ANANKE_TEST_TRUE(TestFramework, Operation->ShouldDefer(9.0, 10.0, 2));
+		Operation->Defer(0.1f);
+		Operation->Defer(0.1f);
+
+		// But not so often that they starve.
+		ANANKE_TEST_FALSE(TestFramework, Operation->ShouldDefer(9.0, 10.0, 2));
+		ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Operation->ConsumeDeferredTime(), 0.2f));
+		ANANKE_TEST_EQUAL(TestFramework, Operation->GetConsecutiveDeferrals(), 0);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->GetTotalDeferrals(), 2);
+
+		// Normal priority operations only once the budget is spent, and high priority operations never.
+		Operation->Priority = EM2OperationPriority::Normal;
+		ANANKE_TEST_FALSE(TestFramework, Operation->ShouldDefer(9.0, 10.0, 2));
+		ANANKE_TEST_TRUE(TestFramework, Operation->ShouldDefer(11.0, 10.0, 2));
+		Operation->Priority = EM2OperationPriority::High;
+		ANANKE_TEST_FALSE(TestFramework, Operation->ShouldDefer(11.0, 10.0, 2));
+	}
+
+	void Test_TimeSlicedSweep()
+	{
+		TArray<FM2RecordHandle> Players;
+		for (int32 Count = 0; Count < 10; ++Count)
+		{
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+		}
+
+		UM2TestOperation_Sweep* Operation = NewObject<UM2TestOperation_Sweep>();
+		Operation->RecordBudget = 3;
+		Operation->Initialize(Registry.Get());
+
+		Operation->Run(Ctx);
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->VisitCounts.Num(), 6);
+
+		// Removing a visited record swaps the last (unvisited) record behind the cursor. It still needs to be visited.
+		FM2RecordHandle RemovedPlayer = Registry->GetRecordSet<UM2TestSet_Player>()->GetHandles()[1];
+		Registry->RemoveRecord(RemovedPlayer);
+		Players.Remove(RemovedPlayer);
+
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->NumSweepsFinished, 0);
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->NumSweepsFinished, 1);
+
+		for (const FM2RecordHandle& Player : Players)
+		{
+			int32* VisitCount = Operation->VisitCounts.Find(Player);
+			ANANKE_TEST_TRUE(TestFramework, VisitCount && *VisitCount == 1);
+		}
+
+		// The next run starts a new sweep.
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->VisitCounts.FindRef(Players[0]), 2);
+	}
+
+	void Test_PublishedField()
+	{
+		FM2RecordHandle Player = Registry->AddRecord<UM2TestSet_Player>();
+		Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition = FVector(1.0f, 0.0f, 0.0f);
+
+		TM2PublishedField<UM2TestSet_Player, FM2TestField_Avatar> PublishedField;
+		PublishedField.Capture(*Registry);
+
+		// Captured results aren't visible until they're published.
+		ANANKE_TEST_EQUAL(TestFramework, PublishedField.GetValues().Num(), 0);
+		PublishedField.Publish();
+		if (!ANANKE_TEST_EQUAL(TestFramework, PublishedField.GetValues().Num(), 1))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, PublishedField.Find(Player)->WorldPosition.Equals(FVector(1.0f, 0.0f, 0.0f)));
+
+		// Only the latest capture is published, and publishing without a new capture keeps the current results.
+		Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition = FVector(2.0f, 0.0f, 0.0f);
+		PublishedField.Capture(*Registry);
+		Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition = FVector(3.0f, 0.0f, 0.0f);
+		PublishedField.Capture(*Registry);
+		PublishedField.Publish();
+		PublishedField.Publish();
+		ANANKE_TEST_TRUE(TestFramework, PublishedField.Find(Player)->WorldPosition.Equals(FVector(3.0f, 0.0f, 0.0f)));
+
+		Registry->RemoveRecord(Player);
+		PublishedField.Capture(*Registry);
+		PublishedField.Publish();
+		ANANKE_TEST_TRUE(TestFramework, PublishedField.Find(Player) == nullptr);
+
+		// Sharded types are captured from every shard, not just the main set.
+		Registry->EnableSharding<UM2TestSet_Player>(&FM2TestField_Avatar::WorldPosition, FBox(FVector(0.0f), FVector(200.0f, 100.0f, 100.0f)), 100.0f);
+		TArray<FM2RecordHandle> ShardedPlayers;
+		Registry->OnRecordMoved().AddLambda([&ShardedPlayers](const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle)
+		{
+			ShardedPlayers.Add(NewHandle);
+		});
+		for (const float X : {50.0f, 150.0f})
+		{
+			Player = Registry->AddRecord<UM2TestSet_Player>();
+			Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition = FVector(X, 50.0f, 50.0f);
+		}
+		Registry->MigrateShardedRecords();
+		
+		PublishedField.Capture(*Registry);
+		PublishedField.Publish();
+		ANANKE_TEST_EQUAL(TestFramework, PublishedField.GetValues().Num(), 2);
+		for (const FM2RecordHandle& ShardedPlayer : ShardedPlayers)
+		{
+			ANANKE_TEST_TRUE(TestFramework, PublishedField.Find(ShardedPlayer) != nullptr);
+		}
+	}
+
+	void Test_ChunkScheduler()
+	{
+		TSet<FM2RecordHandle> Records;
+		for (int32 Count = 0; Count < 10; ++Count)
+		{
+			Records.Add(Registry->AddRecord<UM2TestSet_Player>());
+		}
+		for (int32 Count = 0; Count < 3; ++Count)
+		{
+			Records.Add(Registry->AddRecord<UM2TestSet_Door>());
+		}
+
+		FM2ChunkScheduler Scheduler;
+		Scheduler.ChunkSize = 4;
+		Scheduler.BuildChunks({Registry->GetRecordSet<UM2TestSet_Player>(), Registry->GetRecordSet<UM2TestSet_Door>()});
+		ANANKE_TEST_EQUAL(TestFramework, Scheduler.GetChunks().Num(), 4);
+		ANANKE_TEST_EQUAL(TestFramework, Scheduler.GetNumRecords(), 13);
+
+		// Every record is visited exactly once, by whichever worker picked up its chunk.
+		TArray<TArray<FM2RecordHandle>> Scratch;
+		Scheduler.ForEachChunk(Scratch, [](TArray<FM2RecordHandle>& Visited, const FM2RecordChunk& Chunk)
+		{
+			TArrayView<FM2RecordHandle> Handles = Chunk.RecordSet->GetHandles();
+			for (int32 RecordIndex = Chunk.StartIndex; RecordIndex < Chunk.EndIndex; ++RecordIndex)
+			{
+				Visited.Add(Handles[RecordIndex]);
+			}
+		});
+
+		TArray<FM2RecordHandle> AllVisited;
+		for (const TArray<FM2RecordHandle>& Visited : Scratch)
+		{
+			AllVisited.Append(Visited);
+		}
+		ANANKE_TEST_EQUAL(TestFramework, AllVisited.Num(), 13);
+		ANANKE_TEST_EQUAL(TestFramework, TSet<FM2RecordHandle>(AllVisited).Num(), 13);
+		for (const FM2RecordHandle& Visited : AllVisited)
+		{
+			ANANKE_TEST_TRUE(TestFramework, Records.Contains(Visited));
+		}
+	}
+
+	void Test_ChunkCostModel()
+	{
+		FM2ChunkCostModel CostModel;
+		CostModel.MinParallelMicroseconds = 200.0f;
+		CostModel.TargetChunkMicroseconds = 50.0f;
+
+		// Nothing is parallelized until the operation has been measured.
+		ANANKE_TEST_FALSE(TestFramework, CostModel.ShouldRunParallel(100000));
+
+		// 0.125us per record: 1000 records is too little work to split, 100k records is plenty.
+		CostModel.RecordRun(1000, 125.0);
+		ANANKE_TEST_FALSE(TestFramework, CostModel.ShouldRunParallel(1000));
+		ANANKE_TEST_TRUE(TestFramework, CostModel.ShouldRunParallel(100000));
+		ANANKE_TEST_EQUAL(TestFramework, CostModel.GetChunkSize(), 400);
+
+		// Expensive records get smaller chunks, down to the minimum.
+		for (int32 Run = 0; Run < 50; ++Run)
+		{
+			CostModel.RecordRun(100, 1000.0);
+		}
+		ANANKE_TEST_TRUE(TestFramework, CostModel.ShouldRunParallel(100));
+		ANANKE_TEST_EQUAL(TestFramework, CostModel.GetChunkSize(), CostModel.MinChunkSize);
+	}
+
+	void Test_KernelFusion()
+	{
+		TArray<FM2RecordHandle> Players;
+		for (int32 Count = 0; Count < 3; ++Count)
+		{
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(Players.Last())->WorldPosition = FVector(1.0f, 0.0f, 0.0f);
+		}
+
+		UM2TestKernel_Offset* Offset = NewObject<UM2TestKernel_Offset>();
+		UM2TestKernel_Scale* Scale = NewObject<UM2TestKernel_Scale>();
+		Offset->Initialize(Registry.Get());
+		Scale->Initialize(Registry.Get());
+		ANANKE_TEST_TRUE(TestFramework, Offset->CanFuseWith(*Scale));
+
+		// Throttled kernels run on their own schedule, so they are never fused.
+		Scale->TickIntervalFrames = 2;
+		ANANKE_TEST_FALSE(TestFramework, Offset->CanFuseWith(*Scale));
+		Scale->TickIntervalFrames = 1;
+
+		UM2FusedKernelOperation* Fused = NewObject<UM2FusedKernelOperation>();
+		Fused->AddKernel(*Offset);
+		Fused->AddKernel(*Scale);
+		Fused->Initialize(Registry.Get());
+		Fused->Run(Ctx);
+
+		// Both kernels ran, in order, over the same single chunk.
+		ANANKE_TEST_EQUAL(TestFramework, Offset->NumChunksProcessed, 1);
+		ANANKE_TEST_EQUAL(TestFramework, Scale->NumChunksProcessed, 1);
+		for (const FM2RecordHandle& Player : Players)
+		{
+			ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition.X, 4.0));
+		}
+	}
+
+	void Test_Broadphase()
+	{
+		TArray<FM2RecordHandle> Players;
+		for (const float X : {0.0f, 15.0f, 100.0f})
+		{
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(Players.Last())->WorldPosition = FVector(X, 0.0f, 0.0f);
+		}
+
+		UM2TestBroadphase* Broadphase = NewObject<UM2TestBroadphase>();
+		Broadphase->Channel = TEXT("Players");
+		Broadphase->Execution = EM2ChunkExecution::Serial;
+		Broadphase->Initialize(Registry.Get());
+		Broadphase->Run(Ctx);
+
+		UM2CollisionPairBuffer* Buffer = Registry->GetShared<UM2CollisionPairBuffer>();
+		TConstArrayView<FM2CollisionPair> Pairs = Buffer->GetPairs(TEXT("Players"));
+		if (ANANKE_TEST_EQUAL(TestFramework, Pairs.Num(), 1))
+		{
+			ANANKE_TEST_TRUE(TestFramework, (Pairs[0].A == Players[0] && Pairs[0].B == Players[1]) || (Pairs[0].A == Players[1] && Pairs[0].B == Players[0]));
+		}
+
+		// Moving a record past others reorders it incrementally, and a still scene needs no reordering.
+		Registry->GetField<FM2TestField_Avatar>(Players[2])->WorldPosition.X = 5.0f;
+		Broadphase->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetPairs(TEXT("Players")).Num(), 3);
+		ANANKE_TEST_TRUE(TestFramework, Broadphase->GetNumSortSwaps() > 0);
+		Broadphase->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Broadphase->GetNumSortSwaps(), 0);
+
+		// Parallel runs find the same pairs, including the ones across a chunk boundary. Enough isolated records are
+		// added for several chunks, with the overlapping ones sorted right where the first chunk ends.
+		FM2ChunkCostModel& CostModel = Broadphase->GetCostModel();
+		CostModel.MaxChunkSize = CostModel.MinChunkSize;
+		for (int32 Index = 0; Index < 2 * CostModel.MinChunkSize; ++Index)
+		{
+			const float X = Index < CostModel.MinChunkSize - 2 ? -1000.0f - Index * 100.0f : 1000.0f + Index * 100.0f;
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(Players.Last())->WorldPosition = FVector(X, 0.0f, 0.0f);
+		}
+		Broadphase->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetPairs(TEXT("Players")).Num(), 3);
+		
+		Broadphase->Execution = EM2ChunkExecution::Parallel;
+		Broadphase->Run(Ctx);
+		ANANKE_TEST_TRUE(TestFramework, Broadphase->DidLastRunInParallel());
+		ANANKE_TEST_TRUE(TestFramework, CostModel.GetChunkSize() < Players.Num());
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetPairs(TEXT("Players")).Num(), 3);
+
+		// With two queries, only pairs across the queries are reported, first query first.
+		FM2RecordHandle Door = Registry->AddRecord<UM2TestSet_Door>();
+		Registry->GetField<FM2TestField_Avatar>(Door)->WorldPosition = FVector(10.0f, 0.0f, 0.0f);
+		
+		UM2TestBroadphase* DoorBroadphase = NewObject<UM2TestBroadphase>();
+		DoorBroadphase->Channel = TEXT("Doors");
+		DoorBroadphase->bAgainstDoors = true;
+		DoorBroadphase->Initialize(Registry.Get());
+		DoorBroadphase->Run(Ctx);
+		
+		Pairs = Buffer->GetPairs(TEXT("Doors"));
+		ANANKE_TEST_EQUAL(TestFramework, Pairs.Num(), 3);
+		for (const FM2CollisionPair& Pair : Pairs)
+		{
+			ANANKE_TEST_TRUE(TestFramework, Pair.B == Door && Players.Contains(Pair.A));
+		}
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetPairs(TEXT("Players")).Num(), 3);
+
+		// A run with nothing to pair doesn't report the previous run's mode.
+		Players.Add(Door);
+		for (const FM2RecordHandle& Record : Players)
+		{
+			Registry->RemoveRecord(Record);
+		}
+		Broadphase->Run(Ctx);
+		ANANKE_TEST_FALSE(TestFramework, Broadphase->DidLastRunInParallel());
+		ANANKE_TEST_EQUAL(TestFramework, Buffer->GetPairs(TEXT("Players")).Num(), 0);
+	}
+
+	void Test_CoroutineOperation()
+	{
+		UM2TestOperation_Coroutine* Operation = NewObject<UM2TestOperation_Coroutine>();
+		Operation->bRestartWhenFinished = false;
+		Operation->Event = FGraphEvent::CreateGraphEvent();
+
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 1);
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 2);
+
+		// The task stays suspended until the event completes.
+		Operation->Run(Ctx);
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 2);
+		ANANKE_TEST_TRUE(TestFramework, Operation->HasActiveTask());
+
+		Operation->Event->DispatchSubsequents();
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(Operation->Event);
+
+		// Well within the budget, so the task runs to the end without yielding again.
+		Operation->Run(Ctx);
+		if (!ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 4))
+		{
+			return;
+		}
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps[3], FName(TEXT("Finished")));
+		ANANKE_TEST_FALSE(TestFramework, Operation->HasActiveTask());
+
+		// Finished tasks aren't restarted unless the operation asks for it.
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 4);
+		Operation->bRestartWhenFinished = true;
+		Operation->Run(Ctx);
+		ANANKE_TEST_EQUAL(TestFramework, Operation->Steps.Num(), 5);
+	}
+
+	void Test_SimulationInstances()
+	{
+		TArray<TStrongObjectPtr<UM2SimulationInstance>> Instances;
+		TArray<UM2SimulationInstance*> InstancePtrs;
+		for (int32 InstanceIndex = 0; InstanceIndex < 4; ++InstanceIndex)
+		{
+			UM2SimulationInstance* Instance = Instances.Emplace_GetRef(NewObject<UM2SimulationInstance>()).Get();
+			Instance->Initialize(UM2TestRegistry::StaticClass());
+			for (int32 Count = 0; Count <= InstanceIndex; ++Count)
+			{
+				Instance->GetRegistry()->AddRecord<UM2TestSet_Player>();
+			}
+
+			FM2EngineLoopOptions Options;
+			Options.OperationGroups.AddDefaulted_GetRef().Operations.Add(Instance->NewOperation<UM2TestKernel_Offset>());
+			Instance->ConfigureLoop(Options);
+			Instance->FinishConfiguration();
+			InstancePtrs.Add(Instance);
+		}
+
+		UM2SimulationInstance::StepInstances(InstancePtrs, 0.1f, 3);
+
+		// Every instance only stepped its own records.
+		for (int32 InstanceIndex = 0; InstanceIndex < Instances.Num(); ++InstanceIndex)
+		{
+			UM2SimulationInstance* Instance = Instances[InstanceIndex].Get();
+			ANANKE_TEST_TRUE(TestFramework, Instance->IsThreadSafe());
+			
+			TArrayView<FM2TestField_Avatar> Avatars = Instance->GetRegistry()->GetRecordSet<UM2TestSet_Player>()->GetFieldArray<FM2TestField_Avatar>();
+			ANANKE_TEST_EQUAL(TestFramework, Avatars.Num(), InstanceIndex + 1);
+			for (const FM2TestField_Avatar& Avatar : Avatars)
+			{
+				ANANKE_TEST_TRUE(TestFramework, FMath::IsNearlyEqual(Avatar.WorldPosition.X, 3.0));
+			}
+		}
+
+		// Instances stagger throttled operations the same way the engine does.
+		TStrongObjectPtr<UM2SimulationInstance> Throttled(NewObject<UM2SimulationInstance>());
+		Throttled->Initialize(UM2TestRegistry::StaticClass());
+		
+		TArray<FName> RunOrder;
+		FM2EngineLoopOptions Options;
+		FM2OperationGroup& OperationGroup = Options.OperationGroups.AddDefaulted_GetRef();
+		for (int32 Count = 0; Count < 2; ++Count)
+		{
+			TWeakObjectPtr<UM2TestOperation_Recorder> Recorder = Throttled->NewOperation<UM2TestOperation_Recorder>();
+			Recorder->TickIntervalFrames = 2;
+			Recorder->RunOrder = &RunOrder;
+			OperationGroup.Operations.Add(Recorder);
+		}
+		Throttled->ConfigureLoop(Options);
+		Throttled->FinishConfiguration();
+		ANANKE_TEST_EQUAL(TestFramework, OperationGroup.Operations[0]->PhaseOffset, 0);
+		ANANKE_TEST_EQUAL(TestFramework, OperationGroup.Operations[1]->PhaseOffset, 1);
+
+		Throttled->Step(0.1f);
+		if (ANANKE_TEST_EQUAL(TestFramework, RunOrder.Num(), 1))
+		{
+			ANANKE_TEST_EQUAL(TestFramework, RunOrder[0], OperationGroup.Operations[0]->GetFName());
+		}
+		Throttled->Step(0.1f);
+		if (ANANKE_TEST_EQUAL(TestFramework, RunOrder.Num(), 2))
+		{
+			ANANKE_TEST_EQUAL(TestFramework, RunOrder[1], OperationGroup.Operations[1]->GetFName());
+		}
+	}
+
+	// IMPORTANT! Be sure to register your fn inside your AutomationTest class below!
+
+private:
+	FAutomationTestBase* TestFramework;
+	
+	// Test objects
+	TStrongObjectPtr<UWorld> TestWorld;
+	TStrongObjectPtr<UM2TestRegistry> Registry;
+
+	FM2OperationContext Ctx;
+};
+
+#define REGISTER_TEST_SUITE_FN(TargetTestName) Tests.Add(TEXT(#TargetTestName), &OperationTestSuite::TargetTestName)
+
+class FOperationTests: public FAutomationTestBase
+{
+public:
+	typedef void (OperationTestSuite::*TestFunction)();
+	
+	FOperationTests(const FString& TestName): FAutomationTestBase(TestName, false)
+	{
+		REGISTER_TEST_SUITE_FN(Test_TickInterval);
+		REGISTER_TEST_SUITE_FN(Test_FixedTimestep);
+		REGISTER_TEST_SUITE_FN(Test_Step);
+		REGISTER_TEST_SUITE_FN(Test_RunOnAnyThread);
+		REGISTER_TEST_SUITE_FN(Test_FrameBudgetDeferral);
+		REGISTER_TEST_SUITE_FN(Test_TimeSlicedSweep);
+		REGISTER_TEST_SUITE_FN(Test_PublishedField);
+		REGISTER_TEST_SUITE_FN(Test_ChunkScheduler);
+		REGISTER_TEST_SUITE_FN(Test_ChunkCostModel);
+		REGISTER_TEST_SUITE_FN(Test_KernelFusion);
+		REGISTER_TEST_SUITE_FN(Test_Broadphase);
+		REGISTER_TEST_SUITE_FN(Test_CoroutineOperation);
+		REGISTER_TEST_SUITE_FN(Test_SimulationInstances);
+	}
+	
+	virtual EAutomationTestFlags GetTestFlags() const override
+	{
+		return EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter;
+	}
+	virtual bool IsStressTest() const { return false; }
+	virtual uint32 GetRequiredDeviceNum() const override { return 1; }
+
+protected:
+	virtual FString GetBeautifiedTestName() const override
+	{
+		return "Mantle2.Runtime.OperationTests";
+	}
+	virtual void GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const override
+	{
+		TArray<FString> TargetTestNames;
+		Tests.GetKeys(TargetTestNames);
+		for (const FString& TargetTestName : TargetTestNames)
+		{
+			OutBeautifiedNames.Add(TargetTestName);
+			OutTestCommands.Add(TargetTestName);
+		}
+	}
+	virtual bool RunTest(const FString& Parameters) override
+	{
+		TestFunction* CurrentTest = Tests.Find(Parameters);
+		if (!CurrentTest || !*CurrentTest)
+		{
+			M2_LOG(LogM2Test, Error, TEXT("Cannot find test: %s"), *Parameters);
+			return false;
+		}
+
+		OperationTestSuite Suite(this);
+		(Suite.**CurrentTest)(); // Run the current test from the test suite.
+
+		return true;
+	}
+
+	TMap<FString, TestFunction> Tests;
+};
+
+namespace
+{
+	FOperationTests FOperationTestsInstance(TEXT("FOperationTests"));
+}
+
+#endif //WITH_EDITOR
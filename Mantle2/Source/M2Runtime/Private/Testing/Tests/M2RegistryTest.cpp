@@ -31,7 +31,9 @@
 
 #include "Containers/Array.h"
 #include "Containers/UnrealString.h"
+#include "Foundation/M2BoundsTree.h"
 #include "Foundation/M2Registry.h"
+#include "Foundation/M2SpatialIndex.h"
 #include "Logging/LogVerbosity.h"
 #include "Logging/M2LoggingDefs.h"
 #include "Logging/M2LoggingMacros.h"
@@ -439,6 +441,267 @@ public:
 	    TestRegistry->SharedObjects.Empty();
 	}
 
+	void Test_ShardedRecordSets()
+	{
+		const FBox Bounds(FVector(0.0f), FVector(200.0f, 100.0f, 100.0f));
+		ANANKE_TEST_TRUE(TestFramework, Registry->EnableSharding<UM2TestSet_Player>(&FM2TestField_Avatar::WorldPosition, Bounds, 100.0f));
+		const FM2ShardGrid* ShardGrid = Registry->GetShardGrid(UM2TestSet_Player::StaticClass());
+		if (!ANANKE_TEST_TRUE(TestFramework, ShardGrid != nullptr))
+		{
+			return;
+		}
+		ANANKE_TEST_EQUAL(TestFramework, ShardGrid->Shards.Num(), 2);
+
+		// New records start in the main set, and are moved into their shard by the next migration.
+		FM2RecordHandle Player = Registry->AddRecord<UM2TestSet_Player>();
+		Registry->GetField<FM2TestField_Avatar>(Player)->WorldPosition = FVector(150.0f, 50.0f, 50.0f);
+
+		FM2RecordHandle MovedFrom;
+		FM2RecordHandle MovedTo;
+		Registry->OnRecordMoved().AddLambda([&](const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle)
+		{
+			MovedFrom = OldHandle;
+			MovedTo = NewHandle;
+		});
+		
+		ANANKE_TEST_EQUAL(TestFramework, Registry->MigrateShardedRecords(), 1);
+		ANANKE_TEST_TRUE(TestFramework, MovedFrom == Player);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(Player));
+		ANANKE_TEST_TRUE(TestFramework, Registry->HasRecord(MovedTo));
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetRecordSet(MovedTo) == ShardGrid->Shards[1]);
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetField<FM2TestField_Avatar>(MovedTo)->WorldPosition.Equals(FVector(150.0f, 50.0f, 50.0f)));
+
+		// Region queries only return the shards they overlap, plus the main set.
+		TArray<UScriptStruct*> Match = {FM2TestField_Avatar::StaticStruct()};
+		TArray<UScriptStruct*> Exclude = {FM2TestField_Door::StaticStruct(), FM2TestField_StaticEnvironment::StaticStruct()};
+		TArray<UM2RecordSet*> RegionSets = Registry->GetAll(Match, Exclude, FBox(FVector(0.0f), FVector(50.0f)));
+		ANANKE_TEST_TRUE(TestFramework, RegionSets.Contains(ShardGrid->Shards[0]));
+		ANANKE_TEST_FALSE(TestFramework, RegionSets.Contains(ShardGrid->Shards[1]));
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetAll(Match, Exclude).Contains(ShardGrid->Shards[1]));
+
+		// Records that are already in the right shard stay put.
+		ANANKE_TEST_EQUAL(TestFramework, Registry->MigrateShardedRecords(), 0);
+	}
+
+	void Test_CellStreaming()
+	{
+		const FName CellName(TEXT("TestCell"));
+		UM2TestSet_Player* PlayerSet = Registry->GetRecordSet<UM2TestSet_Player>();
+		
+		TArray<FM2RecordHandle> CellPlayers;
+		for (int32 Count = 0; Count < 3; ++Count)
+		{
+			CellPlayers.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(CellPlayers.Last())->WorldPosition = FVector(Count, 0.0f, 0.0f);
+			Registry->AssignRecordToCell(CellPlayers.Last(), CellName);
+		}
+		FM2RecordHandle OtherPlayer = Registry->AddRecord<UM2TestSet_Player>();
+
+		ANANKE_TEST_EQUAL(TestFramework, Registry->UnloadCell(CellName), 3);
+		ANANKE_TEST_TRUE(TestFramework, Registry->IsCellUnloaded(CellName));
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetUnloadedCellSize(CellName) > 0);
+		ANANKE_TEST_EQUAL(TestFramework, PlayerSet->Num(), 1);
+		ANANKE_TEST_FALSE(TestFramework, Registry->HasRecord(CellPlayers[0]));
+		ANANKE_TEST_TRUE(TestFramework, Registry->HasRecord(OtherPlayer));
+
+		// Loading the cell brings every record back with its old handle and data.
+		ANANKE_TEST_EQUAL(TestFramework, Registry->LoadCell(CellName), 3);
+		ANANKE_TEST_FALSE(TestFramework, Registry->IsCellUnloaded(CellName));
+		ANANKE_TEST_EQUAL(TestFramework, PlayerSet->Num(), 4);
+		for (int32 Count = 0; Count < CellPlayers.Num(); ++Count)
+		{
+			FM2TestField_Avatar* Avatar = Registry->GetField<FM2TestField_Avatar>(CellPlayers[Count]);
+			if (ANANKE_TEST_TRUE(TestFramework, Avatar != nullptr))
+			{
+				ANANKE_TEST_TRUE(TestFramework, Avatar->WorldPosition.Equals(FVector(Count, 0.0f, 0.0f)));
+			}
+			ANANKE_TEST_TRUE(TestFramework, Registry->GetRecordCell(CellPlayers[Count]) == CellName);
+		}
+	}
+
+	void Test_SpatialIndex()
+	{
+		// Keep the test records far away from the records added during setup.
+		const FVector Origin(10000.0f);
+		TArray<FM2RecordHandle> Players;
+		for (int32 Count = 0; Count < 4; ++Count)
+		{
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(Players.Last())->WorldPosition = Origin + FVector(Count * 100.0f, 0.0f, 0.0f);
+		}
+
+		UM2SpatialIndex* SpatialIndex = UM2SpatialIndex::Create(*Registry, &FM2TestField_Avatar::WorldPosition, 100.0f);
+		if (!ANANKE_TEST_TRUE(TestFramework, SpatialIndex != nullptr))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetSpatialIndex<FM2TestField_Avatar>() == SpatialIndex);
+		const int32 NumIndexed = SpatialIndex->Num();
+
+		TArray<FM2RecordHandle> Results;
+		SpatialIndex->QueryRadius(Origin, 150.0f, Results);
+		ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 2);
+		ANANKE_TEST_TRUE(TestFramework, Results.Contains(Players[0]) && Results.Contains(Players[1]));
+
+		Results.Reset();
+		SpatialIndex->QueryBox(FBox(Origin + FVector(150.0f, -10.0f, -10.0f), Origin + FVector(350.0f, 10.0f, 10.0f)), Results);
+		ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 2);
+		ANANKE_TEST_TRUE(TestFramework, Results.Contains(Players[2]) && Results.Contains(Players[3]));
+
+		Results.Reset();
+		SpatialIndex->QueryNearest(Origin + FVector(290.0f, 0.0f, 0.0f), 2, 1000.0f, Results);
+		if (ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 2))
+		{
+			ANANKE_TEST_TRUE(TestFramework, Results[0] == Players[3]);
+			ANANKE_TEST_TRUE(TestFramework, Results[1] == Players[2]);
+		}
+
+		// Records that stay in their cell aren't rebucketed, and the index only sees moves after an update.
+		Registry->GetField<FM2TestField_Avatar>(Players[0])->WorldPosition += FVector(10.0f, 0.0f, 0.0f);
+		Registry->GetField<FM2TestField_Avatar>(Players[1])->WorldPosition += FVector(0.0f, 500.0f, 0.0f);
+		Results.Reset();
+		SpatialIndex->QueryRadius(Origin + FVector(100.0f, 500.0f, 0.0f), 10.0f, Results);
+		ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 0);
+		
+		Registry->UpdateSpatialIndices();
+		ANANKE_TEST_EQUAL(TestFramework, SpatialIndex->GetNumRebucketed(), 1);
+		SpatialIndex->QueryRadius(Origin + FVector(100.0f, 500.0f, 0.0f), 10.0f, Results);
+		ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 1);
+		const FVector* IndexedPosition = SpatialIndex->GetIndexedPosition(Players[0]);
+		if (ANANKE_TEST_TRUE(TestFramework, IndexedPosition != nullptr))
+		{
+			ANANKE_TEST_TRUE(TestFramework, IndexedPosition->Equals(Origin + FVector(10.0f, 0.0f, 0.0f)));
+		}
+
+		// Removed records drop out of the index.
+		Registry->RemoveRecord(Players[3]);
+		Registry->UpdateSpatialIndices();
+		ANANKE_TEST_EQUAL(TestFramework, SpatialIndex->Num(), NumIndexed - 1);
+		ANANKE_TEST_TRUE(TestFramework, SpatialIndex->GetIndexedPosition(Players[3]) == nullptr);
+		Results.Reset();
+		SpatialIndex->QueryRadius(Origin + FVector(300.0f, 0.0f, 0.0f), 10.0f, Results);
+		ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 0);
+
+		// A record two rings out can be closer than one in the point's own cell, if the point sits near a cell face.
+		const FVector FaceOrigin(-20000.0f);
+		FM2RecordHandle SameCell = Registry->AddRecord<UM2TestSet_Player>();
+		Registry->GetField<FM2TestField_Avatar>(SameCell)->WorldPosition = FaceOrigin + FVector(99.0f, 99.0f, 99.0f);
+		FM2RecordHandle TwoRingsOut = Registry->AddRecord<UM2TestSet_Player>();
+		Registry->GetField<FM2TestField_Avatar>(TwoRingsOut)->WorldPosition = FaceOrigin + FVector(-100.5f, 50.0f, 50.0f);
+		Registry->UpdateSpatialIndices();
+		
+		Results.Reset();
+		SpatialIndex->QueryNearest(FaceOrigin + FVector(1.0f, 50.0f, 50.0f), 1, 1000.0f, Results);
+		if (ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 1))
+		{
+			ANANKE_TEST_TRUE(TestFramework, Results[0] == TwoRingsOut);
+		}
+
+		// An unbounded search is limited by the occupied cells instead.
+		Results.Reset();
+		SpatialIndex->QueryNearest(FaceOrigin + FVector(1.0f, 50.0f, 50.0f), 1, BIG_NUMBER, Results);
+		if (ANANKE_TEST_EQUAL(TestFramework, Results.Num(), 1))
+		{
+			ANANKE_TEST_TRUE(TestFramework, Results[0] == TwoRingsOut);
+		}
+	}
+
+	void Test_BoundsTree()
+	{
+		// Keep the test records far away from the records added during setup.
+		const FVector Origin(10000.0f);
+		TArray<FM2RecordHandle> Players;
+		for (int32 Count = 0; Count < 20; ++Count)
+		{
+			Players.Add(Registry->AddRecord<UM2TestSet_Player>());
+			Registry->GetField<FM2TestField_Avatar>(Players.Last())->WorldPosition = Origin + FVector(Count * 100.0f, 0.0f, 0.0f);
+		}
+
+		TArray<UScriptStruct*> Exclude = {FM2TestField_Door::StaticStruct(), FM2TestField_StaticEnvironment::StaticStruct()};
+		UM2BoundsTree* BoundsTree = UM2BoundsTree::Create(*Registry, &FM2TestField_Avatar::WorldPosition, FVector(10.0f), Exclude);
+		if (!ANANKE_TEST_TRUE(TestFramework, BoundsTree != nullptr))
+		{
+			return;
+		}
+		ANANKE_TEST_TRUE(TestFramework, Registry->GetBoundsTree<FM2TestField_Avatar>() == BoundsTree);
+
+		FM2BoundsRay Ray;
+		Ray.Start = Origin - FVector(50.0f, 0.0f, 0.0f);
+		Ray.End = Origin + FVector(5000.0f, 0.0f, 0.0f);
+		TArray<FM2BoundsRay> Rays = {Ray, Ray, Ray};
+		Rays[1].Ignore = Players[0];
+
+		// Passes beside every record, so it only hits as a sweep.
+		Rays[2].Start.Y += 50.0f;
+		Rays[2].End.Y += 50.0f;
+
+		FM2BoundsHit Hit;
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[0], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[0]);
+		ANANKE_TEST_TRUE(TestFramework, Hit.Location.Equals(Origin - FVector(10.0f, 0.0f, 0.0f), 0.1f));
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[1], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[1]);
+		ANANKE_TEST_FALSE(TestFramework, BoundsTree->Raycast(Rays[2], Hit));
+		Rays[2].Extent = FVector(45.0f);
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[2], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[0]);
+
+		// Batches give the same answers as single rays.
+		TArray<FM2BoundsHit> Hits;
+		BoundsTree->RaycastBatch(Rays, Hits);
+		if (ANANKE_TEST_EQUAL(TestFramework, Hits.Num(), 3))
+		{
+			ANANKE_TEST_TRUE(TestFramework, Hits[0].Handle == Players[0]);
+			ANANKE_TEST_TRUE(TestFramework, Hits[1].Handle == Players[1]);
+			ANANKE_TEST_TRUE(TestFramework, Hits[2].Handle == Players[0]);
+		}
+
+		// Moving records only refits the tree.
+		Registry->GetField<FM2TestField_Avatar>(Players[0])->WorldPosition.Y += 1000.0f;
+		Registry->UpdateBoundsTrees();
+		ANANKE_TEST_FALSE(TestFramework, BoundsTree->DidLastUpdateRebuild());
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[0], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[1]);
+
+		// Adding or removing records rebuilds it.
+		Registry->RemoveRecord(Players[1]);
+		Registry->UpdateBoundsTrees();
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->DidLastUpdateRebuild());
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[0], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[2]);
+
+		// Refitted trees are rebuilt after MaxRefits refits in a row.
+		BoundsTree->MaxRefits = 2;
+		for (int32 Update = 0; Update < BoundsTree->MaxRefits; ++Update)
+		{
+			Registry->GetField<FM2TestField_Avatar>(Players[2])->WorldPosition.Z += 1.0f;
+			BoundsTree->Update();
+			ANANKE_TEST_FALSE(TestFramework, BoundsTree->DidLastUpdateRebuild());
+		}
+		BoundsTree->Update();
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->DidLastUpdateRebuild());
+		ANANKE_TEST_TRUE(TestFramework, BoundsTree->Raycast(Rays[0], Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Players[2]);
+
+		// Records can also store their bounds in a field.
+		TArray<FM2RecordHandle> Walls;
+		for (const float X : {300.0f, 200.0f})
+		{
+			Walls.Add(Registry->AddRecord<UM2TestSet_Wall>());
+			Registry->GetField<FM2TestField_StaticEnvironment>(Walls.Last())->Bounds = FBox(Origin + FVector(X, 200.0f, -50.0f), Origin + FVector(X + 20.0f, 400.0f, 50.0f));
+		}
+		UM2BoundsTree* WallTree = UM2BoundsTree::Create(*Registry, &FM2TestField_StaticEnvironment::Bounds);
+		if (!ANANKE_TEST_TRUE(TestFramework, WallTree != nullptr))
+		{
+			return;
+		}
+		Ray.Start = Origin + FVector(0.0f, 300.0f, 0.0f);
+		Ray.End = Origin + FVector(1000.0f, 300.0f, 0.0f);
+		ANANKE_TEST_TRUE(TestFramework, WallTree->Raycast(Ray, Hit));
+		ANANKE_TEST_TRUE(TestFramework, Hit.Handle == Walls[1]);
+		ANANKE_TEST_TRUE(TestFramework, Hit.Location.Equals(Origin + FVector(200.0f, 300.0f, 0.0f), 0.1f));
+	}
+
 	// IMPORTANT! Be sure to register your fn inside your AutomationTest class below!
 
 private:
@@ -477,6 +740,10 @@ public:
 		REGISTER_TEST_SUITE_FN(Test_ProcessArchetype);
 		REGISTER_TEST_SUITE_FN(Test_ProcessArchetypeWithTags);
 		REGISTER_TEST_SUITE_FN(Test_GetShared);
+		REGISTER_TEST_SUITE_FN(Test_ShardedRecordSets);
+		REGISTER_TEST_SUITE_FN(Test_CellStreaming);
+		REGISTER_TEST_SUITE_FN(Test_SpatialIndex);
+		REGISTER_TEST_SUITE_FN(Test_BoundsTree);
 	}
 	
 	virtual EAutomationTestFlags GetTestFlags() const override
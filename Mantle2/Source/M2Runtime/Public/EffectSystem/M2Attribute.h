@@ -0,0 +1,107 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "Foundation/M2Types.h"
+#include "UObject/Object.h"
+
+#include "M2Attribute.generated.h"
+
+// Base struct for numeric attribute fields (health, move speed, ...). Derive a field from this to let effects modify it
+// through attribute modifiers. Derived fields must not add any members of their own, since the modifier pass treats
+// every attribute column as an array of FM2Attribute.
+USTRUCT()
+struct M2RUNTIME_API FM2Attribute
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere)
+	float Value = 0.0f;
+};
+
+UENUM()
+enum class EM2AttributeModifierOp : uint8
+{
+	// Summed, then added to the current value.
+	Add,
+	// Multiplied together, then applied after all Add modifiers.
+	Multiply,
+	// Replaces the value outright. If an attribute has more than one override, the largest magnitude wins.
+	Override
+};
+
+USTRUCT()
+struct M2RUNTIME_API FM2AttributeModifier
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	FM2RecordHandle Target = FM2RecordHandle();
+
+	// The attribute field to modify. Must be a child of FM2Attribute.
+	UPROPERTY()
+	TObjectPtr<UScriptStruct> Attribute = nullptr;
+
+	UPROPERTY()
+	EM2AttributeModifierOp Op = EM2AttributeModifierOp::Add;
+
+	UPROPERTY()
+	float Magnitude = 0.0f;
+};
+
+// Collects attribute modifiers emitted by effects until UM2AttributeAggregator applies them. Use the registry's shared
+// instance (Registry->GetShared<UM2AttributeModifierBuffer>()) so every producer writes into the same buffer. Nothing
+// is applied, and the buffer keeps growing, unless a UM2AttributeAggregator is scheduled.
+UCLASS()
+class M2RUNTIME_API UM2AttributeModifierBuffer : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void AddModifier(const FM2RecordHandle& Target, UScriptStruct* Attribute, EM2AttributeModifierOp Op, float Magnitude);
+
+	template <typename AttributeType>
+	void AddModifier(const FM2RecordHandle& Target, EM2AttributeModifierOp Op, float Magnitude)
+	{
+		static_assert(std::is_base_of_v<FM2Attribute, AttributeType>);
+		AddModifier(Target, AttributeType::StaticStruct(), Op, Magnitude);
+	}
+
+	TArray<FM2AttributeModifier>& GetModifiers() { return Modifiers; }
+	
+	void Reset() { Modifiers.Reset(); }
+
+protected:
+	UPROPERTY(Transient)
+	TArray<FM2AttributeModifier> Modifiers;
+};
@@ -0,0 +1,77 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "Foundation/M2Operation.h"
+
+class UM2AttributeModifierBuffer;
+
+#include "M2AttributeAggregator.generated.h"
+
+/**
+ * Applies every attribute modifier emitted since the last run, then clears the modifier buffer. Schedule this after
+ * the effect manager (and anything else that emits modifiers).
+ *
+ * Modifiers are sorted by record set, attribute and record before they are applied, so each attribute column is
+ * fetched once and walked in order, and the result doesn't depend on the order the modifiers were emitted in. For each
+ * record and attribute: Value = (Value + Sum(Add)) * Product(Multiply), unless there is an Override.
+ */
+UCLASS()
+class M2RUNTIME_API UM2AttributeAggregator : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(UM2Registry* Registry) override;
+	virtual bool IsThreadSafe() const override { return true; }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+
+private:
+	// A modifier that has been resolved to a record set and a record index.
+	struct FResolvedModifier
+	{
+		UM2RecordSet* RecordSet = nullptr;
+		UScriptStruct* Attribute = nullptr;
+		int32 RecordIndex = INDEX_NONE;
+		EM2AttributeModifierOp Op = EM2AttributeModifierOp::Add;
+		float Magnitude = 0.0f;
+	};
+	
+	TArray<FResolvedModifier> ResolvedModifiers;
+
+	// Record sets and attributes that modifiers targeted without the set having the field, so each is only reported once.
+	TSet<TPair<UM2RecordSet*, UScriptStruct*>> WarnedMissingFields;
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<UM2AttributeModifierBuffer> CachedBuffer;
+};
@@ -35,6 +35,17 @@
 
 #include "M2Effect.generated.h"
 
+#if STATS
+// Stats that are created for each effect class the first time it is processed.
+struct FM2EffectClassStats
+{
+	// Cycle counter around TickEffect and the other effect callbacks.
+	TStatId TickStatId;
+	// The number of active effects of this class, reset every frame.
+	TStatId ActiveCountStatId;
+};
+#endif
+
 UCLASS(Blueprintable, HideDropdown)
 class M2RUNTIME_API UM2Effect : public UObject
 {
@@ -43,7 +54,43 @@ class M2RUNTIME_API UM2Effect : public UObject
 public:
 	virtual EM2EffectTriggerResponse TickEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) { return EM2EffectTriggerResponse::Continue; }
 
+	// Override this to return true if TickEffect can handle Ctx.TriggerCount > 1. Otherwise, when the effect manager
+	// fast-forwards over a large time step, TickEffect is called once for each trigger that came due.
+	virtual bool SupportsBatchedTriggers() const { return false; }
+
 	virtual void OnFinishEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) { }
 	virtual void OnCancelEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) { }
 	virtual void OnDeleteEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) { }
+
+	// When a record this effect refers to is removed, the effect manager cleans up the effect according to these
+	// policies before any other effects tick that frame.
+	UPROPERTY(EditDefaultsOnly)
+	EM2EffectDependencyPolicy OnTargetRemoved = EM2EffectDependencyPolicy::Cancel;
+
+	UPROPERTY(EditDefaultsOnly)
+	EM2EffectDependencyPolicy OnInstigatorRemoved = EM2EffectDependencyPolicy::Keep;
+
+	UPROPERTY(EditDefaultsOnly)
+	EM2EffectDependencyPolicy OnInstanceDataRemoved = EM2EffectDependencyPolicy::Delete;
+
+	// How re-applying this effect to a target that already has it is handled. Anything other than Independent merges
+	// the new application into the existing instance instead of creating a new record.
+	UPROPERTY(EditDefaultsOnly)
+	EM2EffectStackingPolicy StackingPolicy = EM2EffectStackingPolicy::Independent;
+
+	// The stack limit for EM2EffectStackingPolicy::AddStack.
+	UPROPERTY(EditDefaultsOnly)
+	int32 MaxStacks = FM2EffectMetadata::kUnlimitedStacks;
+
+	// By default, only applications from the same instigator are merged.
+	UPROPERTY(EditDefaultsOnly)
+	bool bStackAcrossInstigators = false;
+
+#if STATS
+	// Effects are shared objects, so these are effectively per-class. Shows up under `stat M2` and in Unreal Insights.
+	const FM2EffectClassStats& GetStats();
+
+private:
+	TOptional<FM2EffectClassStats> ClassStats;
+#endif
 };
@@ -34,6 +34,15 @@
 
 #include "M2EffectInstance.generated.h"
 
+class UM2Effect;
+
+enum class EM2EffectIndexKey : uint8
+{
+	Target,
+	Instigator,
+	InstanceData
+};
+
 UCLASS()
 class M2RUNTIME_API UM2EffectInstance : public UM2RecordSet
 {
@@ -43,4 +52,123 @@ public:
 	virtual void Initialize() override;
 
 	M2_DECLARE_FIELD(FM2EffectMetadata, Metadata);
-};
\ No newline at end of file
+	M2_DECLARE_FIELD(FInstancedStruct, Payload);
+
+	/**
+	 * Adds a new effect and immediately indexes it by its target and instigator. Prefer this over AddRecord(), since
+	 * records added that way won't show up in the index queries below until the effect manager first processes them.
+	 *
+	 * If the effect's stacking policy merges it into an instance that is already active, no new record is added.
+	 * 
+	 * @param InMetadata - The metadata for the new effect.
+	 * @return - Returns the handle of the new effect, or of the existing effect it was merged into.
+	 */
+	FM2RecordHandle AddEffect(const FM2EffectMetadata& InMetadata);
+
+	/**
+	 * Same as AddEffect(InMetadata), but also stores an inline payload for the effect. The payload is handed to the
+	 * effect's callbacks through FM2EffectContext::Payload.
+	 *
+	 * If the new application is merged into an existing effect, the payload only replaces the existing one when the
+	 * existing effect takes on the new application's values (ie: EM2EffectStackingPolicy::KeepStrongest).
+	 */
+	FM2RecordHandle AddEffect(const FM2EffectMetadata& InMetadata, const FInstancedStruct& InPayload);
+
+	template <typename PayloadType>
+	FM2RecordHandle AddEffect(const FM2EffectMetadata& InMetadata, const PayloadType& InPayload)
+	{
+		return AddEffect(InMetadata, FInstancedStruct::Make(InPayload));
+	}
+
+	// Returns the inline payload for an effect, or nullptr if the effect doesn't exist.
+	FInstancedStruct* GetPayload(const FM2RecordHandle& EffectHandle)
+	{
+		return GetField<FInstancedStruct>(EffectHandle);
+	}
+
+	/**
+	 * Merges a new application of an effect into a matching active instance, according to the effect's stacking policy.
+	 *
+	 * @param InMetadata - The metadata for the new application.
+	 * @param IgnoreHandle - An effect that should not be merged into (ie: the new application itself).
+	 * @param InPayload - The payload for the new application, if it has one.
+	 * @return - Returns the handle of the effect that was merged into, or an unset handle if nothing was merged.
+	 */
+	FM2RecordHandle StackEffect(
+		const FM2EffectMetadata& InMetadata,
+		const FM2RecordHandle& IgnoreHandle = FM2RecordHandle(),
+		const FInstancedStruct* InPayload = nullptr
+	);
+
+	// Adds an effect to the target/instigator/instance data indices, if it hasn't been indexed already.
+	void IndexEffect(const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata);
+
+	// Removes an effect from the indices, if it was indexed.
+	void UnindexEffect(const FM2RecordHandle& EffectHandle, FM2EffectMetadata& EffectMetadata);
+
+	// Clears and rebuilds the indices from the current metadata.
+	void RebuildIndices();
+
+	// Points every effect that refers to OldHandle (as its target, instigator or instance data) at NewHandle instead.
+	// Called by the effect manager when a record moves to another set. See UM2Registry::OnRecordMoved.
+	void RemapRecord(const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle);
+
+	// Returns true if any effect refers to this record as its target, instigator or instance data.
+	bool IsReferenced(const FM2RecordHandle& RecordHandle) const
+	{
+		return EffectsByTarget.Contains(RecordHandle) || EffectsByInstigator.Contains(RecordHandle) || EffectsByInstanceData.Contains(RecordHandle);
+	}
+
+	/**
+	 * Calls Callback for every active effect that refers to Key in the given role.
+	 *
+	 * @param IndexKey - Which index to search.
+	 * @param Key - The record the effects refer to.
+	 * @param EffectClass - If set, only effects of this class (or a subclass) are visited.
+	 * @param Callback - Called with the handle and metadata of each matching effect.
+	 */
+	void ForEachIndexedEffect(
+		EM2EffectIndexKey IndexKey,
+		const FM2RecordHandle& Key,
+		TSubclassOf<UM2Effect> EffectClass,
+		TFunctionRef<void(const FM2RecordHandle&, FM2EffectMetadata&)> Callback
+	);
+
+	/**
+	 * Finds all active effects on a target record.
+	 *
+	 * @param Target - The record the effects are applied to.
+	 * @param OutEffects - Handles for all the matching effects.
+	 * @param EffectClass - If set, only effects of this class (or a subclass) are returned.
+	 */
+	void GetEffectsOnTarget(const FM2RecordHandle& Target, TArray<FM2RecordHandle>& OutEffects, TSubclassOf<UM2Effect> EffectClass = nullptr);
+	void GetEffectsFromInstigator(const FM2RecordHandle& Instigator, TArray<FM2RecordHandle>& OutEffects, TSubclassOf<UM2Effect> EffectClass = nullptr);
+
+	int32 CountEffectsOnTarget(const FM2RecordHandle& Target, TSubclassOf<UM2Effect> EffectClass = nullptr);
+	int32 CountEffectsFromInstigator(const FM2RecordHandle& Instigator, TSubclassOf<UM2Effect> EffectClass = nullptr);
+
+	/**
+	 * Cancels all active effects on a target record. The effects go through the usual Cancel -> Delete flow the next
+	 * time the effect manager runs.
+	 *
+	 * @param Target - The record the effects are applied to.
+	 * @param EffectClass - If set, only effects of this class (or a subclass) are cancelled.
+	 * @return - The number of effects that were cancelled.
+	 */
+	int32 CancelEffectsOnTarget(const FM2RecordHandle& Target, TSubclassOf<UM2Effect> EffectClass = nullptr);
+	int32 CancelEffectsFromInstigator(const FM2RecordHandle& Instigator, TSubclassOf<UM2Effect> EffectClass = nullptr);
+
+protected:
+	virtual void PreRemoveRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex) override;
+	virtual void PostLoadRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex) override;
+	virtual void PostMoveRecord(UM2RecordSet& Source, const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle, int32 RecordIndex) override;
+
+	TMultiMap<FM2RecordHandle, FM2RecordHandle>& GetIndex(EM2EffectIndexKey IndexKey);
+	static const FM2RecordHandle& GetIndexedKey(EM2EffectIndexKey IndexKey, const FM2EffectMetadata& EffectMetadata);
+
+	// Note, these are NOT marked as UPROPERTY. Like the field functions, they should be rebuilt (see RebuildIndices)
+	// whenever this RecordSet is deserialized.
+	TMultiMap<FM2RecordHandle, FM2RecordHandle> EffectsByTarget;
+	TMultiMap<FM2RecordHandle, FM2RecordHandle> EffectsByInstigator;
+	TMultiMap<FM2RecordHandle, FM2RecordHandle> EffectsByInstanceData;
+};
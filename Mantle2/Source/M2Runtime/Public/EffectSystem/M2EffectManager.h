@@ -32,6 +32,9 @@
 #pragma once
 #include "Foundation/M2Operation.h"
 
+class UM2AttributeModifierBuffer;
+class UM2EffectInstance;
+
 #include "M2EffectManager.generated.h"
 
 UCLASS()
@@ -40,11 +43,45 @@ class UM2EffectManager : public UM2Operation
 	GENERATED_BODY()
 
 public:
+	static constexpr float kFastForwardDisabled = -1.0f;
+	
 	virtual void Initialize(UM2Registry* Registry) override;
 
+	/**
+	 * Advances every effect by Ctx.DeltaTime in a single step, firing all of the triggers that came due during that
+	 * time. Use this for offline progress or when resuming a save game instead of simulating every frame.
+	 * 
+	 * @param Ctx - The operation context. DeltaTime may be arbitrarily large.
+	 */
+	void FastForward(FM2OperationContext& Ctx);
+
+	// Frames with a DeltaTime at or above this threshold (ie: after a hitch or a load) are fast-forwarded instead of
+	// firing at most one trigger per effect. Disabled by default.
+	UPROPERTY(EditAnywhere)
+	float FastForwardThresholdSec = kFastForwardDisabled;
+
 protected:
 	virtual void PerformOperation(FM2OperationContext& Ctx) override;
 
+	void ProcessEffects(FM2OperationContext& Ctx, bool bFastForward);
+	void ProcessRemovedRecords(FM2OperationContext& Ctx, UM2EffectInstance& EffectInstances);
+	void HandleRecordRemoved(const FM2RecordHandle& RecordHandle);
+	void HandleRecordMoved(const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle);
+	void FastForwardEffect(UM2Effect& Effect, FM2EffectContext& EffectContext, FM2EffectMetadata& EffectMetadata);
+	void HandleTriggerResponse(EM2EffectTriggerResponse Response, FM2EffectMetadata& EffectMetadata, int32 NumTriggers);
+
 private:
 	TArray<FM2RecordHandle> PendingDeletions;
+
+	// Records that some effect depends on which have been removed since the last time this operation ran.
+	TArray<FM2RecordHandle> RemovedRecords;
+
+	// The effects that depend on one removed record, with what should happen to them. Reused between records.
+	TArray<TPair<FM2RecordHandle, EM2EffectDependencyPolicy>> DependentEffects;
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<UM2EffectInstance> CachedEffectInstances;
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<UM2AttributeModifierBuffer> CachedModifierBuffer;
 };
@@ -0,0 +1,190 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Operation.h"
+#include "M2Registry.h"
+
+#include "M2BoundsTree.generated.h"
+
+// A ray, or a box swept along a line when Extent is non-zero.
+USTRUCT()
+struct M2RUNTIME_API FM2BoundsRay
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector Start = FVector::ZeroVector;
+
+	UPROPERTY()
+	FVector End = FVector::ZeroVector;
+
+	// Half size of the swept box.
+	UPROPERTY()
+	FVector Extent = FVector::ZeroVector;
+
+	// A record to skip, ie: the one doing the shooting.
+	UPROPERTY()
+	FM2RecordHandle Ignore;
+};
+
+USTRUCT()
+struct M2RUNTIME_API FM2BoundsHit
+{
+	GENERATED_BODY()
+
+	// Unset if nothing was hit.
+	UPROPERTY()
+	FM2RecordHandle Handle;
+
+	// How far along the ray the hit is, from 0 (Start) to 1 (End).
+	UPROPERTY()
+	float Time = 1.0f;
+
+	UPROPERTY()
+	FVector Location = FVector::ZeroVector;
+
+	bool IsHit() const { return Handle.IsSet(); }
+};
+
+/**
+ * A bounding volume hierarchy over the bounds of records, for line of sight and hitscan checks against records that
+ * have no actor or collision. Covers every record set with the bounds field, including shards, minus any excluded
+ * sets.
+ *
+ * Update refits the existing tree to the records' current bounds, which is linear and keeps queries exact. The tree is
+ * only rebuilt when records were added or removed, or after MaxRefits refits, since refitted trees get looser as
+ * records drift apart. Queries are read only, so any number of them can run on worker threads at once, as long as
+ * Update isn't running. Schedule UM2BoundsTreeUpdateOperation after the operations that move records.
+ */
+UCLASS()
+class M2RUNTIME_API UM2BoundsTree : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Creates a bounds tree and registers it with the registry. Must be called while configuring, after any record
+	 * sets have been sharded, since the covered sets are looked up once.
+	 *
+	 * @tparam FieldType - The field that holds each record's bounds.
+	 * @param BoundsMember - The bounds member of FieldType, ie: &FMyField::Bounds.
+	 * @param Exclude - Record sets with any of these fields are left out.
+	 */
+	template <typename FieldType>
+	static UM2BoundsTree* Create(UM2Registry& Registry, FBox FieldType::* BoundsMember, const TArray<UScriptStruct*>& Exclude = {})
+	{
+		return CreateInternal(Registry, FieldType::StaticStruct(), Exclude, [BoundsMember](UM2RecordSet& RecordSet, TArray<FBox>& OutBounds)
+		{
+			RecordSet.GetFieldMembers(BoundsMember, OutBounds);
+		});
+	}
+
+	// Same as above, for records with a position and a fixed extent.
+	template <typename FieldType>
+	static UM2BoundsTree* Create(UM2Registry& Registry, FVector FieldType::* PositionMember, const FVector& Extent, const TArray<UScriptStruct*>& Exclude = {})
+	{
+		return CreateInternal(Registry, FieldType::StaticStruct(), Exclude, [PositionMember, Extent](UM2RecordSet& RecordSet, TArray<FBox>& OutBounds)
+		{
+			RecordSet.GetFieldBounds(PositionMember, Extent, OutBounds);
+		});
+	}
+
+	// The tree is rebuilt from scratch after this many refits in a row.
+	int32 MaxRefits = 60;
+
+	// Brings the tree up to date with the records' current bounds.
+	void Update();
+
+	// Finds the closest record hit by a ray or sweep. Safe to call from any thread while the tree isn't updating.
+	bool Raycast(const FM2BoundsRay& Ray, FM2BoundsHit& OutHit) const;
+
+	// Answers a batch of rays on the worker threads. OutHits[i] is the closest hit for Rays[i].
+	void RaycastBatch(TConstArrayView<FM2BoundsRay> Rays, TArray<FM2BoundsHit>& OutHits) const;
+
+	int32 Num() const { return ItemHandles.Num(); }
+
+	// Whether the last Update rebuilt the tree, rather than refitting it.
+	bool DidLastUpdateRebuild() const { return bLastUpdateRebuilt; }
+
+protected:
+	static UM2BoundsTree* CreateInternal(UM2Registry& Registry, UScriptStruct* BoundsField, const TArray<UScriptStruct*>& Exclude, TFunction<void(UM2RecordSet&, TArray<FBox>&)>&& InGetBounds);
+
+	// Gathers every record's bounds. Returns false if the records changed since the last gather.
+	bool GatherItems();
+	void Rebuild();
+	void Refit();
+	void BuildNode(int32 NodeIndex, int32 Begin, int32 End);
+
+	static bool IntersectBox(const FBox& Box, const FVector& Start, const FVector& Delta, float MaxTime, float& OutTime);
+
+	// Leaves hold at most this many records.
+	static constexpr int32 kMaxLeafItems = 4;
+
+	// A leaf if NumItems > 0, with items [First, First + NumItems) of ItemOrder. Otherwise First is the left child,
+	// and the right child follows it. Children always come after their parent.
+	struct FNode
+	{
+		FBox Bounds = FBox(ForceInit);
+		int32 First = 0;
+		int32 NumItems = 0;
+	};
+
+	UPROPERTY(Transient)
+	TArray<TWeakObjectPtr<UM2RecordSet>> CoveredSets;
+
+	TFunction<void(UM2RecordSet&, TArray<FBox>&)> GetBounds;
+
+	TArray<FM2RecordHandle> ItemHandles;
+	TArray<FBox> ItemBounds;
+	TArray<int32> ItemOrder;
+	TArray<FNode> Nodes;
+
+	int32 NumRefits = 0;
+	bool bLastUpdateRebuilt = false;
+
+	// Reused between updates.
+	TArray<FBox> BoundsScratch;
+};
+
+// Updates every bounds tree in the registry. Schedule it after the operations that move records. It isn't thread safe,
+// since a thread safe operation in the same group could be querying the tree while it is rebuilt.
+UCLASS()
+class M2RUNTIME_API UM2BoundsTreeUpdateOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool IsThreadSafe() const override { return false; }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+};
@@ -0,0 +1,174 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2ChunkedOperation.h"
+#include "M2RecordSet.h"
+
+#include "M2Broadphase.generated.h"
+
+// Two records whose bounds overlap. For a two-query broadphase, A is from the first query and B from the second.
+USTRUCT()
+struct M2RUNTIME_API FM2CollisionPair
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FM2RecordHandle A;
+
+	UPROPERTY()
+	FM2RecordHandle B;
+};
+
+// Holds the pairs found by every broadphase this frame, by channel. Use the registry's shared instance
+// (Registry->GetShared<UM2CollisionPairBuffer>()). Each broadphase replaces its channel's pairs every time it runs.
+// Channels are registered from Initialize, on the game thread, so broadphases running side by side never resize the map.
+UCLASS()
+class M2RUNTIME_API UM2CollisionPairBuffer : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	TConstArrayView<FM2CollisionPair> GetPairs(FName Channel) const;
+	void RegisterChannel(FName Channel) { PairsByChannel.FindOrAdd(Channel); }
+	TArray<FM2CollisionPair>& GetMutablePairs(FName Channel) { return PairsByChannel.FindChecked(Channel); }
+
+protected:
+	TMap<FName, TArray<FM2CollisionPair>> PairsByChannel;
+};
+
+UENUM()
+enum class EM2BroadphaseSort : uint8
+{
+	// Sort every record from scratch each run.
+	Full,
+	
+	// Start from last run's order and insertion sort it. Close to linear when records move a little each frame.
+	Incremental
+};
+
+/**
+ * Finds every pair of records whose bounds overlap, with sweep and prune along X. Replaces nested loops over two
+ * queries (ie: projectiles against units) without involving the physics engine.
+ *
+ * Override GetQuery to pick the records, and GetBounds to produce their bounds (see GetFieldBounds). If GetSecondQuery
+ * fills in a query, pairs are only made between the two queries. Otherwise every overlapping pair from the first query
+ * is reported once. Pairs go to the Channel of the shared UM2CollisionPairBuffer, in no particular order.
+ */
+UCLASS(Abstract)
+class M2RUNTIME_API UM2BroadphaseOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(UM2Registry* Registry) override;
+	virtual bool IsThreadSafe() const override { return true; }
+
+	// Where the pairs are written in UM2CollisionPairBuffer. Set before Initialize, which registers the channel.
+	UPROPERTY(EditAnywhere)
+	FName Channel = NAME_None;
+
+	UPROPERTY(EditAnywhere)
+	EM2BroadphaseSort Sort = EM2BroadphaseSort::Incremental;
+
+	// Whether pairs are tested on the worker threads. Auto decides from the measured cost per record.
+	UPROPERTY(EditAnywhere)
+	EM2ChunkExecution Execution = EM2ChunkExecution::Auto;
+
+	// How many elements the last incremental sort had to move. Small when the scene is temporally coherent.
+	int32 GetNumSortSwaps() const { return NumSortSwaps; }
+
+	bool DidLastRunInParallel() const { return bLastRunParallel; }
+
+	FM2ChunkCostModel& GetCostModel() { return CostModel; }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) {}
+	virtual void GetSecondQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) {}
+
+	// Fills OutBounds with the bounds of every record in RecordSet, in record order.
+	virtual void GetBounds(UM2RecordSet& RecordSet, TArray<FBox>& OutBounds) {}
+
+	// GetBounds helper for records that store their bounds in a field.
+	template <typename FieldType>
+	static void GetFieldBounds(UM2RecordSet& RecordSet, FBox FieldType::* BoundsMember, TArray<FBox>& OutBounds)
+	{
+		RecordSet.GetFieldMembers(BoundsMember, OutBounds);
+	}
+
+	// GetBounds helper for records with a position and a fixed extent.
+	template <typename FieldType>
+	static void GetFieldBounds(UM2RecordSet& RecordSet, FVector FieldType::* PositionMember, const FVector& Extent, TArray<FBox>& OutBounds)
+	{
+		RecordSet.GetFieldBounds(PositionMember, Extent, OutBounds);
+	}
+
+private:
+	enum EQuerySide : uint8
+	{
+		First = 1 << 0,
+		Second = 1 << 1
+	};
+
+	struct FEntry
+	{
+		FBox Bounds;
+		FM2RecordHandle Handle;
+		uint8 Sides = 0;
+	};
+
+	void GatherEntries(UM2RecordSet& RecordSet, uint8 Sides);
+	void SortEntries();
+	void FindPairs(int32 EntryIndex, TArray<FM2CollisionPair>& OutPairs) const;
+
+	// Owned by the registry, which outlives its operations.
+	TArray<UM2RecordSet*> FirstSets;
+	TArray<UM2RecordSet*> SecondSets;
+	bool bTwoQueries = false;
+
+	// Sorted by Bounds.Min.X. Kept between runs for the incremental sort.
+	TArray<FEntry> Entries;
+	TArray<FEntry> PreviousEntries;
+	
+	// This run's records, in query order.
+	TArray<FEntry> Gathered;
+	TMap<FM2RecordHandle, int32> GatheredIndices;
+	TArray<FBox> BoundsScratch;
+
+	FM2ChunkCostModel CostModel;
+	int32 NumSortSwaps = 0;
+	bool bLastRunParallel = false;
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<UM2CollisionPairBuffer> CachedBuffer;
+};
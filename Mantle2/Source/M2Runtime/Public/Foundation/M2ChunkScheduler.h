@@ -0,0 +1,144 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "Async/ParallelFor.h"
+#include "Containers/Array.h"
+#include "Containers/ArrayView.h"
+
+class UM2RecordSet;
+
+// A contiguous range of records, [StartIndex, EndIndex), within one record set.
+struct M2RUNTIME_API FM2RecordChunk
+{
+	UM2RecordSet* RecordSet = nullptr;
+	int32 StartIndex = 0;
+	int32 EndIndex = 0;
+
+	int32 Num() const { return EndIndex - StartIndex; }
+};
+
+/**
+ * Tracks how long an operation takes per record, and uses that to decide whether a run is worth parallelizing and how
+ * big its chunks should be. Costs are CPU time summed over every chunk, so parallel and serial runs measure the same
+ * thing.
+ */
+struct M2RUNTIME_API FM2ChunkCostModel
+{
+	// Runs predicted to take less than this are done inline, where dispatch overhead would outweigh the gain.
+	float MinParallelMicroseconds = 200.0f;
+
+	// How long a single chunk should take. Long enough to hide the cost of handing it out, short enough to balance.
+	float TargetChunkMicroseconds = 50.0f;
+
+	int32 MinChunkSize = 64;
+	int32 MaxChunkSize = 16384;
+
+	// Call after every run with the CPU time it took.
+	void RecordRun(int32 NumRecords, double CpuMicroseconds);
+
+	bool HasMeasurements() const { return MicrosecondsPerRecord > 0.0; }
+	double GetMicrosecondsPerRecord() const { return MicrosecondsPerRecord; }
+
+	// Until something has been measured, runs are serial, so the first run produces a clean measurement.
+	bool ShouldRunParallel(int32 NumRecords) const;
+	int32 GetChunkSize() const;
+
+private:
+	double MicrosecondsPerRecord = 0.0;
+};
+
+/**
+ * Runs a function over every record in a set of record sets (ie: the result of a query), in parallel.
+ *
+ * Every set is cut into chunks of at most ChunkSize records, and the chunks from all sets go into a single job pool
+ * that the workers pull from until it is empty. A query that matches many small sets and one huge set keeps every
+ * worker busy until the end, instead of joining after each set.
+ *
+ * The scheduler keeps its chunk list between runs, so reusing one scheduler (ie: as an operation member) doesn't
+ * allocate once it has warmed up. Records must not be added or removed while chunks are being processed.
+ */
+class M2RUNTIME_API FM2ChunkScheduler
+{
+public:
+	static constexpr int32 kDefaultChunkSize = 256;
+
+	// The most records in a chunk. Smaller chunks balance better, larger chunks have less overhead.
+	int32 ChunkSize = kDefaultChunkSize;
+
+	// Cuts the record sets into chunks. Call this whenever the sets may have changed size, ie: once per run.
+	void BuildChunks(TConstArrayView<UM2RecordSet*> RecordSets);
+
+	TConstArrayView<FM2RecordChunk> GetChunks() const { return Chunks; }
+	int32 GetNumRecords() const { return NumRecords; }
+
+	/**
+	 * Calls Function(Scratch, Chunk) for every chunk. Each worker gets its own ScratchType, so chunks can accumulate
+	 * results without locking. Merge OutScratch once this returns.
+	 *
+	 * @param OutScratch - Filled with one default constructed ScratchType per worker that took part.
+	 * @param Function - Called as Function(ScratchType&, const FM2RecordChunk&), possibly from several threads at once.
+	 */
+	template <typename ScratchType, typename FunctionType>
+	void ForEachChunk(TArray<ScratchType>& OutScratch, const FunctionType& Function) const
+	{
+		ParallelForWithTaskContext(
+			TEXT("M2ChunkScheduler"),
+			OutScratch,
+			Chunks.Num(),
+			[this, &Function](ScratchType& Scratch, int32 ChunkIndex) { Function(Scratch, Chunks[ChunkIndex]); },
+			GetParallelForFlags()
+		);
+	}
+
+	// Calls Function(Chunk) for every chunk, possibly from several threads at once.
+	template <typename FunctionType>
+	void ForEachChunk(const FunctionType& Function) const
+	{
+		ParallelFor(
+			TEXT("M2ChunkScheduler"),
+			Chunks.Num(),
+			1,
+			[this, &Function](int32 ChunkIndex) { Function(Chunks[ChunkIndex]); },
+			GetParallelForFlags()
+		);
+	}
+
+private:
+	EParallelForFlags GetParallelForFlags() const
+	{
+		// Chunks are already sized for scheduling, so hand them out one at a time rather than in batches.
+		return Chunks.Num() > 1 ? EParallelForFlags::Unbalanced : EParallelForFlags::ForceSingleThread;
+	}
+	
+	TArray<FM2RecordChunk> Chunks;
+	int32 NumRecords = 0;
+};
@@ -0,0 +1,99 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2ChunkScheduler.h"
+#include "M2Operation.h"
+
+#include "M2ChunkedOperation.generated.h"
+
+UENUM()
+enum class EM2ChunkExecution : uint8
+{
+	// Decide every run, from the operation's measured cost per record.
+	Auto,
+	
+	// Always run inline, on the calling thread.
+	Serial,
+	
+	// Always split the records into chunks and process them in parallel.
+	Parallel
+};
+
+/**
+ * Base class for operations that process every record matching a query, one chunk at a time. Depending on how many
+ * records there are and how expensive each one has been, the chunks are either processed inline or spread across the
+ * worker threads with FM2ChunkScheduler.
+ *
+ * ProcessChunk may be called from several threads at once, so it must only write to the records in its chunk.
+ */
+UCLASS(Abstract)
+class M2RUNTIME_API UM2ChunkedOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(UM2Registry* Registry) override;
+
+	UPROPERTY(EditAnywhere)
+	EM2ChunkExecution Execution = EM2ChunkExecution::Auto;
+
+	// If set, overrides the chunk size picked by the cost model.
+	UPROPERTY(EditAnywhere)
+	int32 ChunkSizeOverride = 0;
+
+	const FM2ChunkCostModel& GetCostModel() const { return CostModel; }
+	FM2ChunkCostModel& GetCostModel() { return CostModel; }
+
+	// True if the last run was split across worker threads.
+	bool DidLastRunInParallel() const { return bLastRunParallel; }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+
+	// Fill these in to select the record sets to process. Called once from Initialize.
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) {}
+
+	// Processes the records in one chunk. Must be safe to call concurrently for different chunks.
+	virtual void ProcessChunk(const FM2OperationContext& Ctx, const FM2RecordChunk& Chunk) {}
+
+	// Called on the calling thread once every chunk has been processed. It is safe to add and remove records here.
+	virtual void PostProcessChunks(FM2OperationContext& Ctx) {}
+
+	// Owned by the registry, which outlives its operations.
+	TArray<UM2RecordSet*> QuerySets;
+
+	FM2ChunkScheduler Scheduler;
+	FM2ChunkCostModel CostModel;
+
+private:
+	bool bLastRunParallel = false;
+};
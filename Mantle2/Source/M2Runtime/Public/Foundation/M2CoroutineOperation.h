@@ -0,0 +1,164 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Operation.h"
+#include "Async/TaskGraphInterfaces.h"
+
+#include <coroutine>
+
+#include "M2CoroutineOperation.generated.h"
+
+/**
+ * The coroutine type returned by UM2CoroutineOperation::RunTask. Inside the coroutine, co_await one of:
+ *
+ *   - FM2OperationTask::NextFrame(): resume on the operation's next run.
+ *   - FM2OperationTask::WaitFor(Event): resume on the first run after Event has completed.
+ *   - FM2OperationTask::YieldIfOverBudget(Microseconds): keep going if the task has been running for less than
+ *     Microseconds since it last resumed, otherwise resume on the next run.
+ */
+class M2RUNTIME_API FM2OperationTask
+{
+public:
+	struct promise_type
+	{
+		// If set, the task doesn't resume until this event has completed.
+		FGraphEventRef WaitEvent;
+		
+		// When the task last resumed, for YieldIfOverBudget.
+		uint64 ResumeStartCycles = 0;
+
+		FM2OperationTask get_return_object() { return FM2OperationTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		
+		// Tasks start suspended, so the operation can set up its context before any of the body runs, and stay
+		// suspended once finished, so the operation can tell that they are done before destroying them.
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		
+		void return_void() {}
+		void unhandled_exception() { checkNoEntry(); }
+	};
+
+	using FHandle = std::coroutine_handle<promise_type>;
+
+	struct FNextFrame
+	{
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(FHandle) const noexcept {}
+		void await_resume() const noexcept {}
+	};
+
+	struct FWaitForEvent
+	{
+		FGraphEventRef Event;
+
+		bool await_ready() const noexcept { return !Event.IsValid() || Event->IsComplete(); }
+		void await_suspend(FHandle Handle) const noexcept { Handle.promise().WaitEvent = Event; }
+		void await_resume() const noexcept {}
+	};
+
+	struct FYieldIfOverBudget
+	{
+		double BudgetMicroseconds = 0.0;
+
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(FHandle Handle) const noexcept
+		{
+			// Returning false resumes the task straight away.
+			const uint64 ElapsedCycles = FPlatformTime::Cycles64() - Handle.promise().ResumeStartCycles;
+			return FPlatformTime::ToMilliseconds64(ElapsedCycles) * 1000.0 >= BudgetMicroseconds;
+		}
+		void await_resume() const noexcept {}
+	};
+
+	static FNextFrame NextFrame() { return FNextFrame(); }
+	static FWaitForEvent WaitFor(FGraphEventRef Event) { return FWaitForEvent{MoveTemp(Event)}; }
+	static FYieldIfOverBudget YieldIfOverBudget(double BudgetMicroseconds) { return FYieldIfOverBudget{BudgetMicroseconds}; }
+
+	FM2OperationTask() = default;
+	FM2OperationTask(FM2OperationTask&& Other) noexcept;
+	FM2OperationTask& operator=(FM2OperationTask&& Other) noexcept;
+	~FM2OperationTask();
+
+	FM2OperationTask(const FM2OperationTask&) = delete;
+	FM2OperationTask& operator=(const FM2OperationTask&) = delete;
+
+	bool IsValid() const { return static_cast<bool>(Handle); }
+	bool IsDone() const { return Handle && Handle.done(); }
+
+	// Returns true if the task is suspended and whatever it was waiting for has happened.
+	bool CanResume() const;
+
+	// Runs the task until it next suspends or finishes.
+	void Resume();
+
+private:
+	explicit FM2OperationTask(FHandle InHandle) : Handle(InHandle) {}
+	
+	FHandle Handle;
+};
+
+/**
+ * Base class for operations whose work spans several runs (ie: batches of pathfinding requests, procedural spawning).
+ * Instead of keeping its progress in members, the operation is written as a coroutine that suspends whenever it needs
+ * to wait, and the engine loop it belongs to resumes it on a later run.
+ *
+ * RunTask is called to start a new task whenever the previous one has finished (or on the first run). The context
+ * passed to each run is available through GetContext() and is refreshed every time the task resumes, so read it again
+ * after every co_await rather than holding on to it.
+ */
+UCLASS(Abstract)
+class M2RUNTIME_API UM2CoroutineOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual void BeginDestroy() override;
+
+	// If false, the operation does nothing once its first task has finished.
+	UPROPERTY(EditAnywhere)
+	bool bRestartWhenFinished = true;
+
+	bool HasActiveTask() const { return Task.IsValid() && !Task.IsDone(); }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+
+	// Override this with a coroutine (ie: a function that uses co_await) to do the operation's work.
+	virtual FM2OperationTask RunTask() { co_return; }
+
+	const FM2OperationContext& GetContext() const { return CurrentContext; }
+
+private:
+	FM2OperationTask Task;
+	FM2OperationContext CurrentContext;
+	bool bHasFinishedTask = false;
+};
@@ -31,6 +31,7 @@
 
 #pragma once
 #include "M2Operation.h"
+#include "M2SimulationThread.h"
 #include "Async/TaskGraphFwd.h"
 #include "Async/TaskGraphInterfaces.h"
 #include "Containers/Array.h"
@@ -44,8 +45,10 @@
 
 #include "M2Engine.generated.h"
 
-// Lightweight container for a collection of operations. We may use this to specify operations that can run concurrently
-// in the future.
+class EngineTestSuite;
+
+// Lightweight container for a collection of operations. Groups always run one after the other. In loops that run off the
+// game thread, the operations within a group run concurrently, so they must not write to the same data.
 USTRUCT()
 struct M2RUNTIME_API FM2OperationGroup
 {
@@ -62,8 +65,58 @@ struct M2RUNTIME_API FM2EngineLoopOptions
 	GENERATED_BODY()
 
 public:
+	static constexpr float kNoFrameBudget = -1.0f;
+	
 	UPROPERTY()
 	TArray<FM2OperationGroup> OperationGroups;
+
+	// If true, the loop's operation groups run in steps of exactly FixedTimestep seconds instead of once per frame
+	// with the frame's DeltaTime. Unused frame time is carried over to the next frame.
+	UPROPERTY()
+	bool bUseFixedTimestep = false;
+
+	UPROPERTY()
+	float FixedTimestep = 1.0f / 60.0f;
+
+	// Caps how many steps a single frame can run, so that a slow frame doesn't snowball into even slower frames. Any
+	// time beyond that is dropped.
+	UPROPERTY()
+	int32 MaxSubsteps = 4;
+
+	// If set, deferrable operations are skipped once running them would take the loop over this many milliseconds in a
+	// frame. See UM2Operation::Priority and UM2Operation::bDeferrable.
+	UPROPERTY()
+	float FrameBudgetMs = kNoFrameBudget;
+
+	// The most frames in a row a low priority operation can be deferred before it is forced to run.
+	UPROPERTY()
+	int32 MaxDeferredFrames = 8;
+
+	// If true, the loop runs on a worker thread, in parallel with other work in the same tick group, and the operations
+	// in each group run concurrently. Every operation in the loop must be thread safe (see UM2Operation::IsThreadSafe).
+	UPROPERTY()
+	bool bRunOnAnyThread = false;
+};
+
+// Where a custom engine phase runs in the frame. See UM2Engine::ConfigureEnginePhase.
+USTRUCT()
+struct M2RUNTIME_API FM2EnginePhaseOptions
+{
+	GENERATED_BODY()
+
+public:
+	// The earliest tick group the phase can run in. Prerequisites in later tick groups push the phase back to theirs.
+	UPROPERTY()
+	TEnumAsByte<ETickingGroup> TickGroup = TG_PrePhysics;
+
+	// Phases that must finish before this one starts. The built-in loops are named after their tick group
+	// (ie: "TG_PrePhysics"), so custom phases can be placed relative to them too.
+	UPROPERTY()
+	TArray<FName> RunAfter;
+
+	// Phases that must not start until this one has finished.
+	UPROPERTY()
+	TArray<FName> RunBefore;
 };
 
 USTRUCT()
@@ -74,12 +127,29 @@ struct FM2EngineLoop : public FTickFunction
 public:
 	FM2EngineLoop();
 
+	UPROPERTY()
+	FName PhaseName;
+
 	UPROPERTY()
 	FM2EngineLoopOptions Options;
 
+	// Phases this loop runs after and before. Resolved to tick prerequisites when the engine finishes configuring.
+	UPROPERTY()
+	TArray<FName> RunAfterPhases;
+
+	UPROPERTY()
+	TArray<FName> RunBeforePhases;
+
+	// Adds the operation groups in NewOptions to the loop, and takes on any loop settings they opt in to.
+	void ApplyOptions(const FM2EngineLoopOptions& NewOptions);
+
 	UPROPERTY()
 	FM2OperationContext OperationContext;
 
+	// Frame time that hasn't been consumed by a fixed step yet.
+	UPROPERTY()
+	float TimeAccumulator = 0.0f;
+
 protected:
 	virtual void ExecuteTick(
 		float DeltaTime,
@@ -87,6 +157,35 @@ protected:
 		ENamedThreads::Type CurrentThread,
 		const FGraphEventRef& MyCompletionGraphEvent
 	) override;
+
+	// Works out how many times the operation groups should run this frame, and sets up the context for those runs.
+	int32 BeginFrame(float DeltaTime);
+	
+	void RunLoop(float DeltaTime);
+	void RunOperationGroups();
+	void RunOperation(UM2Operation& Operation);
+
+	// Dispatches every group as a set of tasks that wait on the previous group. MyCompletionGraphEvent doesn't complete
+	// until the last group has finished.
+	void DispatchLoop(float DeltaTime, const FGraphEventRef& MyCompletionGraphEvent);
+
+	// Prepares the operation groups to run, once their operations have been initialized. Shared by everything that owns
+	// a loop, so that they all run their operations the same way. Fused operations are created in Outer and added to
+	// OwnedOperations.
+	void FinishConfiguration(UObject& Outer, UM2Registry& Registry, TArray<TObjectPtr<UM2Operation>>& OwnedOperations);
+
+	// Replaces runs of fusable kernel operations in each operation group with a single fused operation.
+	void FuseKernelOperations(UObject& Outer, UM2Registry& Registry, TArray<TObjectPtr<UM2Operation>>& OwnedOperations);
+
+	// Assigns phase offsets to throttled operations that didn't pick one, so they are spread out across frames.
+	void StaggerOperations();
+
+	friend class UM2Engine;
+	friend class UM2SimulationInstance;
+	friend class FM2SimulationThread;
+
+	// When the current frame started, for the frame budget.
+	uint64 FrameStartCycles = 0;
 };
 
 template<>
@@ -98,6 +197,51 @@ struct TStructOpsTypeTraits<FM2EngineLoop> : public TStructOpsTypeTraitsBase2<FM
 	};
 };
 
+USTRUCT()
+struct M2RUNTIME_API FM2SimulationOptions
+{
+	GENERATED_BODY()
+
+public:
+	// Operations that run on the simulation thread. Every one of them must be thread safe.
+	UPROPERTY()
+	TArray<FM2OperationGroup> OperationGroups;
+
+	// How many times per second the simulation steps. Each step's DeltaTime is 1 / TickRateHz.
+	UPROPERTY()
+	float TickRateHz = 30.0f;
+};
+
+// Publishes the simulation thread's latest results to the game thread. Runs at the start of TG_PrePhysics, before any of
+// the engine loops.
+USTRUCT()
+struct FM2SimulationSyncTick : public FTickFunction
+{
+	GENERATED_BODY()
+
+public:
+	FM2SimulationSyncTick();
+
+	TWeakObjectPtr<UM2Engine> Engine;
+
+protected:
+	virtual void ExecuteTick(
+		float DeltaTime,
+		ELevelTick TickType,
+		ENamedThreads::Type CurrentThread,
+		const FGraphEventRef& MyCompletionGraphEvent
+	) override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FM2SimulationSyncTick> : public TStructOpsTypeTraitsBase2<FM2SimulationSyncTick>
+{
+	enum
+	{
+		WithCopy = false // It is unsafe to copy FTickFunctions
+	};
+};
+
 UENUM()
 enum class EM2EngineState
 {
@@ -121,12 +265,85 @@ public:
 	// Call this from your game instance to configure which operations run. If you inherit from M2GameInstance
 	// this is all that is needed to get up and running.
 	void ConfigureEngineLoop(const ETickingGroup TickGroup, const FM2EngineLoopOptions& Options);
+
+	/**
+	 * Configures a named phase: an engine loop that runs at an explicit point in the frame, instead of at the start of
+	 * a tick group. Use this when operations need to run between specific actor or component ticks (ie: right after
+	 * character movement, or before the camera update). Configuring an existing phase again adds to its operations.
+	 *
+	 * @param PhaseName - Unique name of the phase. The built-in loops are named after their tick group.
+	 * @param PhaseOptions - Where the phase runs relative to other phases.
+	 * @param Options - The phase's operations and loop settings.
+	 */
+	void ConfigureEnginePhase(const FName PhaseName, const FM2EnginePhaseOptions& PhaseOptions, const FM2EngineLoopOptions& Options);
+
+	// Makes a phase wait for a tick function, ie: a component's PrimaryComponentTick. TargetObject owns the tick function.
+	void AddPhasePrerequisite(const FName PhaseName, UObject* TargetObject, FTickFunction& TickFunction);
+
+	// Makes a tick function wait for a phase, ie: a camera manager's PrimaryActorTick.
+	void AddPhaseDependent(const FName PhaseName, FTickFunction& TickFunction);
+
+	/**
+	 * Runs the given operations on a dedicated simulation thread at their own fixed rate, instead of on the game
+	 * thread's tick. While the engine is started, the game thread must not access the registry directly. Read the
+	 * simulation's results through PublishField and send changes through EnqueueSimulationCommand instead.
+	 *
+	 * The tick group loops and phases keep running on the game thread, for operations that need it (ie: actor sync).
+	 * While the simulation thread is running, they may only contain operations that don't access the registry (see
+	 * UM2Operation::AccessesRegistry). Loops that do are not started.
+	 */
+	void ConfigureSimulation(const FM2SimulationOptions& Options);
+
+	/**
+	 * Publishes a field column from the simulation thread to the game thread. The results are refreshed once per frame,
+	 * before the engine loops tick. Must be called while configuring the engine.
+	 *
+	 * @return - Returns the published copy of the column, for the game thread to read from.
+	 */
+	template <typename RecordSetType, typename FieldType>
+	TSharedPtr<TM2PublishedField<RecordSetType, FieldType>> PublishField()
+	{
+		static_assert(std::is_base_of_v<UM2RecordSet, RecordSetType>);
+		
+		if (!CanPublishFields())
+		{
+			return nullptr;
+		}
+
+		TSharedRef<TM2PublishedField<RecordSetType, FieldType>> PublishedField = MakeShared<TM2PublishedField<RecordSetType, FieldType>>();
+		SimulationThread->AddPublishedField(PublishedField);
+		return PublishedField;
+	}
+
+	// Runs a command on the simulation thread before its next step. Use this to make changes to the registry from the
+	// game thread while the simulation thread is running.
+	void EnqueueSimulationCommand(TFunction<void(UM2Registry&)>&& Command);
+
+	// Called by FM2SimulationSyncTick.
+	void PublishSimulationResults();
+	
 	void FinishConfiguration();
 	
 	void Start(UWorld& World);
 	void Stop();
+
+	// The name records are grouped under (see UM2Registry::AssignRecordToCell) to stream in and out with a level, ie: a
+	// World Partition cell. While the engine is started, records are unloaded and loaded along with their level.
+	static FName GetStreamingCellName(const ULevel& Level);
 	bool IsStarted() { return EngineState == EM2EngineState::Started; }
 
+	/**
+	 * Runs every engine loop NumSteps times, in tick group and phase order, without a world. This is meant for headless
+	 * simulation (ie: server-side what-if simulation, training, benchmarks), so it runs as fast as the operations allow.
+	 * Operations see a null World in their context (with bHeadless set) and should skip any work that needs one.
+	 *
+	 * Only available once the engine has been configured, and while it isn't started.
+	 *
+	 * @param DeltaTime - The time to simulate per step, in seconds.
+	 * @param NumSteps - The number of steps to run.
+	 */
+	void Step(float DeltaTime, int32 NumSteps = 1);
+
 	TObjectPtr<UM2Registry> GetRegistry()
 	{
 		return Registry;
@@ -143,16 +360,33 @@ public:
 			return nullptr;
 		}
 		
+		ensure(IsInGameThread());
 		OperationType* Operation = NewObject<OperationType>(this);
 		Operations.Add(Operation);
 		return TWeakObjectPtr<OperationType>(Operation);
 	}
 
 protected:
+	friend EngineTestSuite;
+	
 	void ResetCounters();
+	bool CanPublishFields();
+
+	void HandleLevelAddedToWorld(ULevel* Level, UWorld* World);
+	void HandleLevelRemovedFromWorld(ULevel* Level, UWorld* World);
 	
 	void ActivateEngineLoop(FM2EngineLoop& TickFunction, UWorld& World);
+
+	// Returns false if the loop has operations that access the registry, which the simulation thread owns while it runs.
+	bool CanRunAlongsideSimulation(const FM2EngineLoop& EngineLoop) const;
 	void DeactivateEngineLoop(FM2EngineLoop& TickFunction);
+	FM2EngineLoop* GetEngineLoop(const ETickingGroup TickGroup);
+	FM2EngineLoop* GetEngineLoop(const FName PhaseName);
+	TArray<FM2EngineLoop*, TInlineAllocator<6>> GetEngineLoops();
+
+	// Turns phase names into tick prerequisites, and works out the order Step runs the loops in.
+	void ResolvePhases();
+
 	
 	UPROPERTY()
 	TObjectPtr<UM2Registry> Registry = nullptr;
@@ -167,5 +401,20 @@ protected:
 	FM2EngineLoop PostPhysicsLoop;
 	FM2EngineLoop FrameEndLoop;
 
+	// Tick functions can't be copied or moved, so custom phases are allocated individually.
+	TArray<TUniquePtr<FM2EngineLoop>> CustomPhases;
+
+	// Every engine loop, in an order that respects tick groups and phase prerequisites. Built by ResolvePhases.
+	TArray<FM2EngineLoop*> OrderedEngineLoops;
+
+	// Never registered as a tick function. The simulation thread runs it directly.
+	FM2EngineLoop SimulationLoop;
+	FM2SimulationSyncTick SimulationSyncTick;
+	TUniquePtr<FM2SimulationThread> SimulationThread;
+
 	EM2EngineState EngineState = EM2EngineState::Initialize;
+
+	TWeakObjectPtr<UWorld> StartedWorld;
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
 };
@@ -0,0 +1,83 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2ChunkedOperation.h"
+
+#include "M2KernelOperation.generated.h"
+
+/**
+ * A chunked operation whose work is a per-record kernel: ProcessChunk reads and writes only the records in its chunk.
+ * Consecutive kernel operations in the same operation group that share a query are fused by the engine. They run as
+ * one pass over the records, with each chunk going through every kernel in order while its columns are still in
+ * cache. They stay separate operations for configuration and profiling.
+ *
+ * Because fused kernels are interleaved chunk by chunk, a kernel must not depend on another kernel having finished
+ * with other records (ie: reductions across the whole set). Set bAllowFusion to false for those.
+ */
+UCLASS(Abstract)
+class M2RUNTIME_API UM2KernelOperation : public UM2ChunkedOperation
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere)
+	bool bAllowFusion = true;
+
+	// Returns true if this kernel can share a pass over the records with the next one.
+	virtual bool CanFuseWith(const UM2KernelOperation& Other) const;
+
+private:
+	friend class UM2FusedKernelOperation;
+};
+
+// Runs a sequence of kernel operations as a single pass over their shared query. Created by the engine.
+UCLASS(HideDropdown)
+class M2RUNTIME_API UM2FusedKernelOperation : public UM2ChunkedOperation
+{
+	GENERATED_BODY()
+
+public:
+	// Kernels run in the order they were added. They must be initialized before the fused operation.
+	void AddKernel(UM2KernelOperation& Kernel);
+
+	TConstArrayView<TObjectPtr<UM2KernelOperation>> GetKernels() const { return Kernels; }
+
+	virtual void Initialize(UM2Registry* Registry) override;
+	virtual bool IsThreadSafe() const override;
+
+protected:
+	virtual void ProcessChunk(const FM2OperationContext& Ctx, const FM2RecordChunk& Chunk) override;
+	virtual void PostProcessChunks(FM2OperationContext& Ctx) override;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UM2KernelOperation>> Kernels;
+};
@@ -50,8 +50,33 @@ public:
 	UPROPERTY()
 	TWeakObjectPtr<UWorld> World = nullptr;
 
+	// True for loops that run without a world: UM2Engine::Step, simulation instances and the simulation thread. Only
+	// then are operations run with a null World.
+	UPROPERTY()
+	bool bHeadless = false;
+
 	UPROPERTY()
 	float DeltaTime = 0.0f;
+
+	// For loops running at a fixed timestep, the fraction of a step that will be left over in the accumulator once the
+	// loop has run all of this frame's steps. It is set once per frame, before the first step, so every step sees the
+	// same value: it is meant for presentation, ie: operations in a later phase that blend between the previous and
+	// current simulation state, not for the simulation steps themselves. Always 1 for loops that use the frame's
+	// DeltaTime.
+	UPROPERTY()
+	float InterpolationAlpha = 1.0f;
+};
+
+// Decides which operations are deferred first when an engine loop runs out of frame budget.
+UENUM()
+enum class EM2OperationPriority : uint8
+{
+	// Deferred as soon as running it would go over the budget.
+	Low,
+	// Only deferred once the budget has already been spent.
+	Normal,
+	// Never deferred.
+	High
 };
 
 UCLASS()
@@ -62,9 +87,89 @@ class M2RUNTIME_API UM2Operation : public UObject
 public:
 	~UM2Operation();
 
+	static constexpr int32 kAutoPhaseOffset = -1;
+	
 	virtual void Initialize(UM2Registry* Registry) {}
 	
 	void Run(FM2OperationContext& Ctx);
+
+	// Override this to return true if the operation only touches record data (and its own members) while it runs, and
+	// never creates, destroys or calls into other UObjects. Only thread safe operations can be added to engine loops
+	// that run off the game thread. See FM2EngineLoopOptions::bRunOnAnyThread.
+	//
+	// In those loops, the operations within an FM2OperationGroup run concurrently with each other, so a thread safe
+	// operation must also not write to anything another operation in its group reads or writes.
+	virtual bool IsThreadSafe() const { return false; }
+
+	// Override this to return false if the operation never reads or writes the registry, ie: it only reads published
+	// fields. While a simulation thread owns the registry, only these operations can run in the game thread's loops.
+	// See UM2Engine::ConfigureSimulation.
+	virtual bool AccessesRegistry() const { return true; }
+
+	// Returns true if this operation doesn't run on every iteration of its engine loop.
+	bool IsThrottled() const { return TickIntervalFrames > 1 || TickIntervalSec > 0.0f; }
+
+	/**
+	 * Called by the engine loop on every iteration to check whether this operation should run.
+	 * 
+	 * @param DeltaTime - The loop's DeltaTime for this iteration.
+	 * @param OutDeltaTime - If the operation should run, the time accumulated since it last ran.
+	 * @return - Returns true if the operation should run this iteration.
+	 */
+	bool ConsumeTickInterval(float DeltaTime, float& OutDeltaTime);
+
+	// Restarts the tick interval, so that the next run happens PhaseOffset iterations after the interval first elapses.
+	void ResetTickInterval();
+
+	// Only run every N iterations of the engine loop. 1 runs the operation on every iteration.
+	UPROPERTY(EditAnywhere)
+	int32 TickIntervalFrames = 1;
+
+	// Only run once at least this many seconds have passed since the last run. 0 disables the time interval. If both
+	// intervals are set, both must have elapsed.
+	UPROPERTY(EditAnywhere)
+	float TickIntervalSec = 0.0f;
+
+	// Delays the operation's first run by this many iterations, to keep throttled operations from all running on the
+	// same frame. If left as kAutoPhaseOffset, UM2Engine staggers the throttled operations in each loop automatically.
+	UPROPERTY(EditAnywhere)
+	int32 PhaseOffset = kAutoPhaseOffset;
+
+	/**
+	 * Called by engine loops with a frame budget to decide whether this operation should be skipped this iteration.
+	 *
+	 * @param ElapsedMs - How much of the budget has been spent so far.
+	 * @param BudgetMs - The loop's frame budget.
+	 * @param MaxDeferrals - How many iterations in a row a Low priority operation may be deferred before it is forced
+	 *                       to run. Normal priority operations get half as many.
+	 * @return - Returns true if the operation should be deferred.
+	 */
+	bool ShouldDefer(double ElapsedMs, double BudgetMs, int32 MaxDeferrals) const;
+
+	// Skips this iteration. The time is handed to the operation the next time it runs.
+	void Defer(float DeltaTime);
+
+	// Registers the per-class deferral stat. Defer can run on worker threads, so this is done on the game thread once
+	// configuration finishes, and Defer only reads it.
+	void CreateStats();
+
+	// Returns the time carried over from deferred iterations and clears it.
+	float ConsumeDeferredTime();
+
+	// Updates the running average cost used to predict whether this operation fits in the remaining budget.
+	void RecordCost(double CostMs);
+
+	double GetAverageCostMs() const { return AverageCostMs; }
+	int32 GetTotalDeferrals() const { return TotalDeferrals; }
+	int32 GetConsecutiveDeferrals() const { return ConsecutiveDeferrals; }
+
+	UPROPERTY(EditAnywhere)
+	EM2OperationPriority Priority = EM2OperationPriority::Normal;
+
+	// If true, engine loops with a frame budget may skip this operation on frames where the budget runs out. Only mark
+	// operations as deferrable if they cope with a larger DeltaTime on the frame they do run.
+	UPROPERTY(EditAnywhere)
+	bool bDeferrable = false;
 	
 	template <typename GameInstanceType>
 	GameInstanceType* GetOwningGameInstance()
@@ -83,4 +188,17 @@ protected:
 	
 	UPROPERTY(Transient)
 	TObjectPtr<UGameInstance> CachedGameInstance;
+
+private:
+	int32 IterationsSinceLastRun = 0;
+	float AccumulatedDeltaTime = 0.0f;
+
+	float DeferredDeltaTime = 0.0f;
+	double AverageCostMs = 0.0;
+	int32 ConsecutiveDeferrals = 0;
+	int32 TotalDeferrals = 0;
+
+#if STATS
+	TOptional<TStatId> DeferralStatId;
+#endif
 };
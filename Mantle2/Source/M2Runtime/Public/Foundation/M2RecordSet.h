@@ -38,6 +38,10 @@
 
 class TestSuite;
 
+// Broadcast by a RecordSet after one of its records has been removed. RecordIndex is the index the removed record used
+// to occupy, which now holds the set's former last record (unless the removed record was the last one).
+DECLARE_MULTICAST_DELEGATE_TwoParams(FM2OnRecordSetRecordRemoved, const FM2RecordHandle& /*RecordHandle*/, int32 /*RecordIndex*/);
+
 // Note: We include Check##FieldType as a simple way of forcing a compilation error if:
 //			1) The field "FieldName" was declared with a different type other than FieldType.
 //			2) Any other field was initialized with the same field type.
@@ -45,6 +49,8 @@ class TestSuite;
 	FieldType* Check##FieldType = FieldName.GetData();																					\
 	AddRecordFns.Add([this]() { return FieldName.AddDefaulted(); });																	\
 	RemoveRecordFns.Add([this](int32 RecordIndex) { FieldName.RemoveAtSwap(RecordIndex); });											\
+	MoveRecordFns.Add([this](UM2RecordSet& Source, int32 SourceIndex)																	\
+		{ FieldName.Last() = MoveTemp(static_cast<decltype(this)>(&Source)->FieldName[SourceIndex]); });								\
 	GetFieldFns.Add(FieldType::StaticStruct(), [this](){ return FAnankeUntypedArrayView(FieldName.GetData(), FieldName.Num()); });		\
 	Archetype.Add(FieldType::StaticStruct());
 
@@ -68,6 +74,8 @@ public:
 	void PreInitialize(FGuid NewSetId);
 	virtual void Initialize();
 
+	const FGuid& GetSetId() const { return SetId; }
+
 	TArrayView<FM2RecordHandle> GetHandles()
 	{
 		return TArrayView<FM2RecordHandle>(RecordHandles);
@@ -95,6 +103,41 @@ public:
 	{
 		return GetFieldInternal(ViewType::StaticStruct()).template GetArrayView<ViewType>();
 	}
+
+	// Copies one member of every record's field into OutValues, in record order, ie: positions for a spatial lookup.
+	template <typename FieldType, typename MemberType>
+	void GetFieldMembers(MemberType FieldType::* Member, TArray<MemberType>& OutValues)
+	{
+		OutValues.Reset();
+		for (const FieldType& Field : GetFieldArray<FieldType>())
+		{
+			OutValues.Add(Field.*Member);
+		}
+	}
+
+	// Same as GetFieldMembers, for records with a position and a fixed extent. Fills OutBounds with a box around each.
+	template <typename FieldType>
+	void GetFieldBounds(FVector FieldType::* PositionMember, const FVector& Extent, TArray<FBox>& OutBounds)
+	{
+		OutBounds.Reset();
+		for (const FieldType& Field : GetFieldArray<FieldType>())
+		{
+			OutBounds.Add(FBox(Field.*PositionMember - Extent, Field.*PositionMember + Extent));
+		}
+	}
+
+	// Fetches a field array through one of the field's base structs. This only works when the field type is a child of
+	// BaseType and doesn't add any members, otherwise an empty view is returned.
+	template <typename BaseType>
+	TArrayView<BaseType> GetFieldArrayAs(UScriptStruct* FieldType)
+	{
+		if (!FieldType || !FieldType->IsChildOf(BaseType::StaticStruct()) || FieldType->GetStructureSize() != sizeof(BaseType))
+		{
+			return TArrayView<BaseType>();
+		}
+		
+		return GetFieldInternal(FieldType).template GetArrayView<BaseType>();
+	}
 	
 	bool MatchArchetype(TArray<UScriptStruct*>& Match, TArray<UScriptStruct*>& Exclude);
 
@@ -108,6 +151,19 @@ public:
 		return Handle.SetId.IsValid() && Handle.SetId == SetId && Handle.RecordId.IsValid() && RecordIndexMap.Contains(Handle.RecordId);
 	}
 
+	// Returns the current index of a record in this set's field arrays, or INDEX_NONE if the record isn't in this set.
+	// Note that indices are not stable: removing a record swaps the last record into its slot.
+	int32 GetRecordIndex(const FM2RecordHandle& Handle)
+	{
+		if (Handle.SetId != SetId)
+		{
+			return INDEX_NONE;
+		}
+		
+		int32* Result = RecordIndexMap.Find(Handle.RecordId);
+		return Result ? *Result : INDEX_NONE;
+	}
+
 	template <typename ViewType>
 	bool HasField()
 	{
@@ -127,6 +183,37 @@ public:
 	FM2RecordHandle AddRecord();
 	virtual FM2RecordHandle AddAndInitializeRecord(const FGameplayTag& InitID);
 	void RemoveRecord(const FM2RecordHandle& RecordHandle);
+
+	/**
+	 * Moves a record from another RecordSet of the same type into this one. The field data is moved over, and the
+	 * record is removed from the source set. The record keeps its RecordId, but its handle changes to this set's.
+	 *
+	 * The record still exists, so PreRemoveRecord isn't called for it. PostMoveRecord is called instead.
+	 *
+	 * @return Returns the record's new handle, or an invalid handle if the record couldn't be moved.
+	 */
+	FM2RecordHandle MoveRecordFrom(UM2RecordSet& Source, const FM2RecordHandle& RecordHandle);
+
+	/**
+	 * Serializes the given records' fields to Ar, then removes the records from this set. Use LoadRecords to bring them
+	 * back. Records that aren't in this set are skipped.
+	 *
+	 * @return Returns the number of records that were saved.
+	 */
+	int32 SaveRecords(FArchive& Ar, TConstArrayView<FM2RecordHandle> Handles);
+
+	/**
+	 * Restores records written by SaveRecords, with the same handles they had when they were saved. Either every record
+	 * is restored or none are: if the data can't be read, the records restored so far are taken back out.
+	 *
+	 * @param OutHandles - Filled with the handles of the restored records.
+	 * @return Returns false if the data doesn't match this set's fields.
+	 */
+	bool LoadRecords(FArchive& Ar, TArray<FM2RecordHandle>& OutHandles);
+
+	// Use this to keep anything that tracks records by index (ie: a cursor) in sync with RemoveAtSwap. Listeners should
+	// not add or remove records from inside the callback.
+	FM2OnRecordSetRecordRemoved& OnRecordRemoved() { return RecordRemovedDelegate; }
 	
 	template <typename GameInstanceType>
 	GameInstanceType* GetOwningGameInstance()
@@ -143,9 +230,28 @@ public:
 protected:
 	friend TestSuite;
 	
-	FM2RecordHandle AddRecordInternal(int32& OutRecordIndex);
+	FM2RecordHandle AddRecordInternal(int32& OutRecordIndex, const FGuid& RecordId = FGuid());
 	FAnankeUntypedArrayView GetFieldInternal(UScriptStruct* FieldType);
 
+	// Returns a pointer to one record's value in a field column, without knowing the field's type.
+	uint8* GetFieldData(UScriptStruct* FieldType, int32 RecordIndex);
+
+	// Removes a record. bSkipHooks skips PreRemoveRecord, for records that aren't going away as far as the hooks are
+	// concerned: records moving to another set, and records a failed load is taking back out.
+	void RemoveRecordInternal(const FM2RecordHandle& RecordHandle, bool bSkipHooks);
+
+	// Called right before a record is removed, while its field data is still valid. Override this if your RecordSet
+	// keeps any bookkeeping that refers to its records.
+	virtual void PreRemoveRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex) {}
+
+	// Called for every record LoadRecords restores, once all of its fields have been read. This mirrors PreRemoveRecord,
+	// which SaveRecords calls as it removes the records.
+	virtual void PostLoadRecord(const FM2RecordHandle& RecordHandle, int32 RecordIndex) {}
+
+	// Called on the set a record was moved into (see MoveRecordFrom), once the record has left Source. Override this
+	// to carry any bookkeeping that refers to the record over from Source.
+	virtual void PostMoveRecord(UM2RecordSet& Source, const FM2RecordHandle& OldHandle, const FM2RecordHandle& NewHandle, int32 RecordIndex) {}
+
 	UPROPERTY()
 	FGuid SetId = FGuid();
 	
@@ -159,8 +265,11 @@ protected:
 	// is deserialized from disk instead of trying to make sure all these pointers are always valid.
 	TArray<TFunction<void()>> AddRecordFns;
 	TArray<TFunction<void(int32)>> RemoveRecordFns;
+	TArray<TFunction<void(UM2RecordSet&, int32)>> MoveRecordFns;
 	TMap<UScriptStruct*, TFunction<FAnankeUntypedArrayView()>> GetFieldFns;
 	TSet<UScriptStruct*> Archetype;
+
+	FM2OnRecordSetRecordRemoved RecordRemovedDelegate;
 	
 	UPROPERTY(Transient)
 	TObjectPtr<UGameInstance> CachedGameInstance;
@@ -36,8 +36,32 @@
 #include "M2Registry.generated.h"
 
 class UM2Engine;
+class UM2BoundsTree;
+class UM2SimulationInstance;
+class UM2SpatialIndex;
 class TestSuite;
 
+DECLARE_MULTICAST_DELEGATE_OneParam(FM2OnRecordRemoved, const FM2RecordHandle&);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FM2OnRecordMoved, const FM2RecordHandle& /*OldHandle*/, const FM2RecordHandle& /*NewHandle*/);
+
+// A record set type that has been split into one set per world-space grid cell. See UM2Registry::EnableSharding.
+struct FM2ShardGrid
+{
+	FBox Bounds = FBox(ForceInit);
+	float CellSize = 0.0f;
+	FIntVector NumCells = FIntVector::ZeroValue;
+
+	// One set per cell, X-major. Kept alive by the registry's SetsById.
+	TArray<UM2RecordSet*> Shards;
+
+	// Fills OutPositions with the position of every record in a set, in record order.
+	TFunction<void(UM2RecordSet&, TArray<FVector>&)> GetPositions;
+
+	// Positions outside the bounds belong to the nearest edge cell.
+	FIntVector GetCell(const FVector& Position) const;
+	int32 GetShardIndex(const FIntVector& Cell) const { return Cell.X + NumCells.X * (Cell.Y + NumCells.Y * Cell.Z); }
+};
+
 UCLASS()
 class M2RUNTIME_API UM2Registry : public UObject
 {
@@ -91,6 +115,10 @@ public:
 	 */
 	void RemoveRecord(const FM2RecordHandle& RecordHandle);
 
+	// Broadcast after a record has been removed from the registry. Use this to clean up anything that refers to the
+	// removed record. Listeners should not add or remove records from inside the callback.
+	FM2OnRecordRemoved& OnRecordRemoved() { return RecordRemovedDelegate; }
+
 	/**
 	 *	Fetches a field for an individual record.
 	 * 
@@ -118,6 +146,18 @@ public:
 		TObjectPtr<UM2RecordSet>* Result = SetsByType.Find(RecordType::StaticClass());
 		return Result ? Cast<RecordType>(Result->Get()) : nullptr;
 	}
+
+	/**
+	 *	Fetches the RecordSet that a record handle belongs to. This does not check that the record itself still exists.
+	 * 
+	 * @param Handle - A handle to any record in the target RecordSet.
+	 * @return Returns a pointer to the matching RecordSet if it exists, otherwise nullptr.
+	 */
+	UM2RecordSet* GetRecordSet(const FM2RecordHandle& Handle)
+	{
+		TObjectPtr<UM2RecordSet>* Result = SetsById.Find(Handle.SetId);
+		return Result ? Result->Get() : nullptr;
+	}
 	
 	/**
 	 * Fetches a list of RecordSets matching the target types, if they exist.
@@ -137,6 +177,116 @@ public:
 	 */
 	TArray<UM2RecordSet*> GetAll(TArray<UScriptStruct*>& Match, TArray<UScriptStruct*>& Exclude);
 
+	/**
+	 * Same as GetAll(Match, Exclude), but for sharded types only returns the shards that overlap Region. Unsharded
+	 * sets are always returned.
+	 */
+	TArray<UM2RecordSet*> GetAll(TArray<UScriptStruct*>& Match, TArray<UScriptStruct*>& Exclude, const FBox& Region);
+
+	/**
+	 * Splits a record set type into one set per world-space cell, so that spatial operations can work on the cells they
+	 * care about (see GetAll with a Region), and so that each cell's records are stored together. Records added with
+	 * AddRecord go into the type's main set, and MigrateShardedRecords moves records into the shard for their position.
+	 *
+	 * Must be called while configuring, before any operations are initialized, since operations look up their record
+	 * sets once. Handles change when a record moves between shards. See OnRecordMoved.
+	 *
+	 * @tparam RecordType - The type of RecordSet to shard.
+	 * @tparam FieldType - The field that holds each record's position.
+	 * @param PositionMember - The position member of FieldType, ie: &FMyField::WorldPosition.
+	 * @param Bounds - The area covered by shards. Records outside of it go into the nearest edge shard.
+	 * @param CellSize - The size of each shard's cell, in world units.
+	 * @return Returns true if the type is now sharded.
+	 */
+	template <typename RecordType, typename FieldType>
+	bool EnableSharding(FVector FieldType::* PositionMember, const FBox& Bounds, float CellSize)
+	{
+		static_assert(std::is_base_of_v<UM2RecordSet, RecordType>);
+		
+		return EnableShardingInternal(RecordType::StaticClass(), Bounds, CellSize, [PositionMember](UM2RecordSet& RecordSet, TArray<FVector>& OutPositions)
+		{
+			RecordSet.GetFieldMembers(PositionMember, OutPositions);
+		});
+	}
+
+	bool IsSharded(TSubclassOf<UM2RecordSet> RecordType) const { return ShardGrids.Contains(RecordType); }
+	const FM2ShardGrid* GetShardGrid(TSubclassOf<UM2RecordSet> RecordType) const { return ShardGrids.Find(RecordType); }
+
+	/**
+	 * Moves every record of a sharded type that isn't in the shard for its position. Call this at step boundaries (ie:
+	 * from UM2ShardMigrationOperation), never while other operations are iterating.
+	 *
+	 * @return Returns the number of records that moved.
+	 */
+	int32 MigrateShardedRecords();
+
+	/**
+	 * Moves a record into another RecordSet of the same type. The record's handle changes.
+	 *
+	 * @return Returns the record's new handle, or an invalid handle if it couldn't be moved.
+	 */
+	FM2RecordHandle MoveRecord(const FM2RecordHandle& RecordHandle, UM2RecordSet& TargetSet);
+
+	// Broadcast after a record has moved to another RecordSet. Use this to update anything that stores its handle.
+	FM2OnRecordMoved& OnRecordMoved() { return RecordMovedDelegate; }
+
+	/**
+	 * Groups a record with the content of a streaming cell (ie: a World Partition cell's level), so that it is unloaded
+	 * and loaded along with it. See UM2Engine::GetStreamingCellName. A record belongs to at most one cell.
+	 */
+	void AssignRecordToCell(const FM2RecordHandle& RecordHandle, FName CellName);
+	FName GetRecordCell(const FM2RecordHandle& RecordHandle) const;
+
+	/**
+	 * Serializes every record in a cell into a compact blob held by the registry, and removes the records from their
+	 * sets. Until the cell is loaded again, the records' handles report HasRecord() == false. OnRecordRemoved is not
+	 * broadcast, since the records still exist.
+	 *
+	 * @return Returns the number of records that were unloaded.
+	 */
+	int32 UnloadCell(FName CellName);
+
+	/**
+	 * Restores every record that was unloaded with a cell, with the handles they had before. If some of the cell's data
+	 * can't be loaded (ie: a record set it refers to is gone), the records that can't be restored stay unloaded, and the
+	 * cell keeps reporting IsCellUnloaded() until a later LoadCell restores them.
+	 *
+	 * Objects the records refer to are found but never loaded, so this can run on the simulation thread. They must
+	 * still be loaded when the cell is.
+	 *
+	 * @return Returns the number of records that were loaded.
+	 */
+	int32 LoadCell(FName CellName);
+
+	bool IsCellUnloaded(FName CellName) const { return UnloadedCells.Contains(CellName); }
+
+	// Returns the size of an unloaded cell's blob in bytes, or 0 if the cell isn't unloaded.
+	int64 GetUnloadedCellSize(FName CellName) const;
+
+	// Returns the spatial index over a position field, or nullptr if there isn't one. See UM2SpatialIndex::Create.
+	UM2SpatialIndex* GetSpatialIndex(UScriptStruct* PositionField) const;
+
+	template <typename FieldType>
+	UM2SpatialIndex* GetSpatialIndex() const
+	{
+		return GetSpatialIndex(FieldType::StaticStruct());
+	}
+
+	// Brings every spatial index up to date. See UM2SpatialIndexUpdateOperation.
+	void UpdateSpatialIndices();
+
+	// Returns the bounds tree over a bounds field, or nullptr if there isn't one. See UM2BoundsTree::Create.
+	UM2BoundsTree* GetBoundsTree(UScriptStruct* BoundsField) const;
+
+	template <typename FieldType>
+	UM2BoundsTree* GetBoundsTree() const
+	{
+		return GetBoundsTree(FieldType::StaticStruct());
+	}
+
+	// Refits or rebuilds every bounds tree. See UM2BoundsTreeUpdateOperation.
+	void UpdateBoundsTrees();
+
 	
 	/**
 	 * Gets a shared object of the target type and casts it to a base type. Useful if you know the base type at compile
@@ -160,6 +310,9 @@ public:
 		
 		if (!SharedObjects.Contains(TargetType) || !IsValid(SharedObjects.FindChecked(TargetType)))
 		{
+			// Shared objects should be created up front (ie: from UM2Operation::Initialize) so that thread safe
+			// operations can look them up from worker threads.
+			ensureMsgf(IsInGameThread(), TEXT("Shared objects can only be constructed on the game thread."));
 			TheObject = NewObject<BaseType>(this, TargetType);
 			bNewlyConstructed = true;
 		}
@@ -199,7 +352,10 @@ public:
 	}
 
 protected:
+	friend UM2BoundsTree;
 	friend UM2Engine;
+	friend UM2SimulationInstance;
+	friend UM2SpatialIndex;
 	friend TestSuite;
 	
 	// By default, the DB will be initialized with 1 copy of each class extending UM2RecordSet found in your codebase.
@@ -230,6 +386,23 @@ protected:
 	UPROPERTY()
 	TMap<UClass*, TObjectPtr<UObject>> SharedObjects;
 
+	FM2OnRecordRemoved RecordRemovedDelegate;
+	FM2OnRecordMoved RecordMovedDelegate;
+
+	bool EnableShardingInternal(TSubclassOf<UM2RecordSet> RecordType, const FBox& Bounds, float CellSize, TFunction<void(UM2RecordSet&, TArray<FVector>&)>&& GetPositions);
+	
+	TMap<TSubclassOf<UM2RecordSet>, FM2ShardGrid> ShardGrids;
+
+	TMap<FName, TSet<FM2RecordHandle>> CellRecords;
+	TMap<FM2RecordHandle, FName> RecordCells;
+	TMap<FName, TArray<uint8>> UnloadedCells;
+
+	UPROPERTY()
+	TMap<TObjectPtr<UScriptStruct>, TObjectPtr<UM2SpatialIndex>> SpatialIndices;
+
+	UPROPERTY()
+	TMap<TObjectPtr<UScriptStruct>, TObjectPtr<UM2BoundsTree>> BoundsTrees;
+
 private:
 	bool IsClassExcluded(UClass* TargetClass);
 };
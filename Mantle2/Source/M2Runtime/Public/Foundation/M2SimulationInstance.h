@@ -0,0 +1,109 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Engine.h"
+#include "UObject/Object.h"
+
+#include "M2SimulationInstance.generated.h"
+
+/**
+ * A self-contained simulation: its own registry, its own operations and its own engine loop, with no world and no
+ * game instance. Use these to host many independent simulations in one process (ie: several small matches on one
+ * dedicated server, or batches of AI training runs), and step them in parallel with StepInstances.
+ *
+ * Instances never share mutable state. Each one owns its registry (and the registry's shared objects) and its
+ * operations, so stepping two instances on different threads at the same time is safe as long as their operations are
+ * thread safe.
+ */
+UCLASS()
+class M2RUNTIME_API UM2SimulationInstance : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Creates the instance's registry. Must be called on the game thread, before anything else.
+	 *
+	 * @param RegistryClass - The type of registry to create. Decides which record sets the instance has.
+	 */
+	void Initialize(TSubclassOf<UM2Registry> RegistryClass);
+
+	// Adds operation groups to the instance's loop. Only the loop's timestep and frame budget settings apply, since
+	// instances choose their own thread when they are stepped.
+	void ConfigureLoop(const FM2EngineLoopOptions& Options);
+
+	void FinishConfiguration();
+
+	// Runs the instance's loop NumSteps times on the calling thread.
+	void Step(float DeltaTime, int32 NumSteps = 1);
+
+	/**
+	 * Steps many instances at once, spread across the worker threads. Instances whose operations aren't all thread
+	 * safe are stepped on the calling thread instead, after the others.
+	 *
+	 * @param DeltaTime - The time to simulate per step, in seconds.
+	 * @param NumSteps - The number of steps to run for every instance.
+	 */
+	static void StepInstances(TConstArrayView<UM2SimulationInstance*> Instances, float DeltaTime, int32 NumSteps = 1);
+
+	UM2Registry* GetRegistry() const { return Registry; }
+	bool IsThreadSafe() const { return bThreadSafe; }
+
+	template<typename OperationType>
+	TWeakObjectPtr<OperationType> NewOperation()
+	{
+		static_assert(std::is_base_of_v<UM2Operation, OperationType>);
+		
+		if (bConfigured)
+		{
+			return nullptr;
+		}
+		
+		ensure(IsInGameThread());
+		OperationType* Operation = NewObject<OperationType>(this);
+		Operations.Add(Operation);
+		return TWeakObjectPtr<OperationType>(Operation);
+	}
+
+protected:
+	UPROPERTY()
+	TObjectPtr<UM2Registry> Registry = nullptr;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UM2Operation>> Operations;
+
+	// Never registered as a tick function. Step runs it directly.
+	FM2EngineLoop Loop;
+
+	bool bConfigured = false;
+	bool bThreadSafe = true;
+};
@@ -0,0 +1,193 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Registry.h"
+#include "Containers/Queue.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/SharedPointer.h"
+
+class FRunnableThread;
+struct FM2EngineLoop;
+
+// A record set column that the simulation thread publishes to the game thread. See UM2Engine::PublishField.
+class M2RUNTIME_API FM2PublishedFieldBase
+{
+public:
+	virtual ~FM2PublishedFieldBase() = default;
+
+	// Simulation thread: copies the live column into the back buffer, then hands it over as the latest results.
+	virtual void Capture(UM2Registry& Registry) = 0;
+
+	// Game thread: makes the latest results visible to readers, if the simulation has captured new ones.
+	virtual void Publish() = 0;
+};
+
+/**
+ * A triple-buffered copy of one field column (and its record handles). The simulation thread writes the back buffer,
+ * the game thread reads the front buffer, and the two only meet for a pointer swap, so neither waits on the other.
+ *
+ * Everything except Capture must be called from the game thread.
+ */
+template <typename RecordSetType, typename FieldType>
+class TM2PublishedField : public FM2PublishedFieldBase
+{
+public:
+	virtual void Capture(UM2Registry& Registry) override
+	{
+		RecordSetType* MainSet = Registry.GetRecordSet<RecordSetType>();
+		if (!MainSet)
+		{
+			return;
+		}
+
+		// Sharded types keep most of their records in the shards, not the main set.
+		TArray<UM2RecordSet*, TInlineAllocator<1>> RecordSets = {MainSet};
+		if (const FM2ShardGrid* ShardGrid = Registry.GetShardGrid(RecordSetType::StaticClass()))
+		{
+			RecordSets.Append(ShardGrid->Shards);
+		}
+
+		// Reset rather than reassign, so the buffers keep their allocations between captures.
+		FBuffer& Back = Buffers[BackIndex];
+		Back.Handles.Reset();
+		Back.Values.Reset();
+		for (UM2RecordSet* RecordSet : RecordSets)
+		{
+			TArrayView<FM2RecordHandle> Handles = RecordSet->GetHandles();
+			TArrayView<FieldType> Values = RecordSet->template GetFieldArray<FieldType>();
+			Back.Handles.Append(Handles.GetData(), Handles.Num());
+			Back.Values.Append(Values.GetData(), Values.Num());
+		}
+
+		FScopeLock Lock(&SwapLock);
+		Swap(BackIndex, ReadyIndex);
+		bHasNewResults = true;
+	}
+
+	virtual void Publish() override
+	{
+		FScopeLock Lock(&SwapLock);
+		if (!bHasNewResults)
+		{
+			return;
+		}
+		
+		Swap(ReadyIndex, FrontIndex);
+		bHasNewResults = false;
+		bFrontIndexDirty = true;
+	}
+
+	TArrayView<const FM2RecordHandle> GetHandles() const { return Buffers[FrontIndex].Handles; }
+	TArrayView<const FieldType> GetValues() const { return Buffers[FrontIndex].Values; }
+
+	// Returns the published value for a record, or nullptr if the record wasn't in the last published results.
+	const FieldType* Find(const FM2RecordHandle& Handle)
+	{
+		const FBuffer& Front = Buffers[FrontIndex];
+		if (bFrontIndexDirty)
+		{
+			// Only built when someone looks up a record by handle, and at most once per publish.
+			FrontIndexMap.Reset();
+			for (int32 RecordIndex = 0; RecordIndex < Front.Handles.Num(); ++RecordIndex)
+			{
+				FrontIndexMap.Add(Front.Handles[RecordIndex], RecordIndex);
+			}
+			bFrontIndexDirty = false;
+		}
+		
+		const int32* RecordIndex = FrontIndexMap.Find(Handle);
+		return RecordIndex ? &Front.Values[*RecordIndex] : nullptr;
+	}
+
+private:
+	struct FBuffer
+	{
+		TArray<FM2RecordHandle> Handles;
+		TArray<FieldType> Values;
+	};
+
+	FBuffer Buffers[3];
+	int32 BackIndex = 0;
+	int32 ReadyIndex = 1;
+	int32 FrontIndex = 2;
+	bool bHasNewResults = false;
+	FCriticalSection SwapLock;
+
+	TMap<FM2RecordHandle, int32> FrontIndexMap;
+	bool bFrontIndexDirty = false;
+};
+
+/**
+ * Runs an engine loop on a dedicated thread at a fixed rate, independently of the game thread's frame rate.
+ *
+ * The game thread must not touch the registry while this thread is running. Instead, it reads the fields the loop
+ * publishes (see TM2PublishedField) and sends changes through EnqueueCommand. Commands run on the simulation thread
+ * at the start of the next step. Each step holds off garbage collection until it finishes, since operations and the
+ * registry are UObjects.
+ */
+class M2RUNTIME_API FM2SimulationThread : public FRunnable
+{
+public:
+	FM2SimulationThread(FM2EngineLoop& InSimulationLoop, UM2Registry& InRegistry, float InTickRateHz);
+	virtual ~FM2SimulationThread() override;
+
+	void StartThread();
+	void StopThread();
+	bool IsRunning() const { return Thread != nullptr; }
+
+	// Runs a single step on the calling thread: pending commands, the simulation loop, then publishing.
+	void StepSimulation(float DeltaTime);
+
+	void AddPublishedField(const TSharedRef<FM2PublishedFieldBase>& PublishedField) { PublishedFields.Add(PublishedField); }
+	void EnqueueCommand(TFunction<void(UM2Registry&)>&& Command) { Commands.Enqueue(MoveTemp(Command)); }
+
+	// Game thread: makes the latest published results visible.
+	void Publish();
+
+	// FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override { bStopRequested = true; }
+
+private:
+	FM2EngineLoop& SimulationLoop;
+	UM2Registry& Registry;
+	float TickRateHz = 30.0f;
+
+	TArray<TSharedRef<FM2PublishedFieldBase>> PublishedFields;
+	TQueue<TFunction<void(UM2Registry&)>, EQueueMode::Mpsc> Commands;
+
+	FRunnableThread* Thread = nullptr;
+	FThreadSafeBool bStopRequested = false;
+};
@@ -0,0 +1,139 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Operation.h"
+#include "M2Registry.h"
+
+#include "M2SpatialIndex.generated.h"
+
+/**
+ * A uniform grid over a position field, for neighbor queries that would otherwise have to brute force over every
+ * record. Covers every record set with the field, including shards.
+ *
+ * The index is a snapshot: queries see positions as of the last Update. Update only rebuckets records whose cell
+ * changed, so it is cheap when most records stay put. Schedule UM2SpatialIndexUpdateOperation after the operations
+ * that move records.
+ */
+UCLASS()
+class M2RUNTIME_API UM2SpatialIndex : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Creates a spatial index and registers it with the registry. Must be called while configuring, after any record
+	 * sets have been sharded, since the indexed sets are looked up once.
+	 *
+	 * @tparam FieldType - The field that holds each record's position.
+	 * @param PositionMember - The position member of FieldType, ie: &FMyField::WorldPosition.
+	 * @param CellSize - The size of each grid cell. Around the most common query radius works well.
+	 */
+	template <typename FieldType>
+	static UM2SpatialIndex* Create(UM2Registry& Registry, FVector FieldType::* PositionMember, float CellSize)
+	{
+		return CreateInternal(Registry, FieldType::StaticStruct(), CellSize, [PositionMember](UM2RecordSet& RecordSet, TArray<FVector>& OutPositions)
+		{
+			RecordSet.GetFieldMembers(PositionMember, OutPositions);
+		});
+	}
+
+	// Brings the index up to date with the records' current positions.
+	void Update();
+
+	// Appends every record within Radius of Center.
+	void QueryRadius(const FVector& Center, float Radius, TArray<FM2RecordHandle>& OutHandles) const;
+
+	// Appends every record inside Box.
+	void QueryBox(const FBox& Box, TArray<FM2RecordHandle>& OutHandles) const;
+
+	/**
+	 * Finds the records closest to Point, nearest first.
+	 *
+	 * @param MaxRadius - Records further away than this are ignored. Keeps the search bounded when there are fewer
+	 *                    than K records nearby.
+	 */
+	void QueryNearest(const FVector& Point, int32 K, float MaxRadius, TArray<FM2RecordHandle>& OutHandles) const;
+
+	// Returns the indexed position of a record, or nullptr if the record isn't indexed.
+	const FVector* GetIndexedPosition(const FM2RecordHandle& Handle) const;
+
+	int32 Num() const { return Entries.Num(); }
+	float GetCellSize() const { return CellSize; }
+	
+	// The number of records whose cell changed during the last Update.
+	int32 GetNumRebucketed() const { return NumRebucketed; }
+
+protected:
+	static UM2SpatialIndex* CreateInternal(UM2Registry& Registry, UScriptStruct* PositionField, float InCellSize, TFunction<void(UM2RecordSet&, TArray<FVector>&)>&& InGetPositions);
+	
+	FIntVector GetCell(const FVector& Position) const;
+	void RemoveFromCell(const FM2RecordHandle& Handle, const FIntVector& Cell);
+
+	struct FEntry
+	{
+		FVector Position = FVector::ZeroVector;
+		FIntVector Cell = FIntVector::ZeroValue;
+		uint32 Epoch = 0;
+	};
+
+	UPROPERTY(Transient)
+	TArray<TWeakObjectPtr<UM2RecordSet>> IndexedSets;
+
+	TFunction<void(UM2RecordSet&, TArray<FVector>&)> GetPositions;
+	float CellSize = 100.0f;
+	
+	TMap<FM2RecordHandle, FEntry> Entries;
+	TMap<FIntVector, TArray<FM2RecordHandle>> Cells;
+	uint32 Epoch = 0;
+
+	// The corners of the block of cells that have records in them. Searches never need to go past it.
+	FIntVector MinOccupiedCell = FIntVector::ZeroValue;
+	FIntVector MaxOccupiedCell = FIntVector::ZeroValue;
+	int32 NumRebucketed = 0;
+
+	// Reused between updates.
+	TArray<FVector> PositionScratch;
+};
+
+// Updates every spatial index in the registry. Schedule it after the operations that move records. It isn't thread
+// safe, since a thread safe operation in the same group could be querying an index while its cells are rebucketed.
+UCLASS()
+class M2RUNTIME_API UM2SpatialIndexUpdateOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool IsThreadSafe() const override { return false; }
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+};
@@ -0,0 +1,99 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "M2Operation.h"
+
+#include "M2TimeSlicedOperation.generated.h"
+
+/**
+ * Base class for operations that need to visit every record matching a query, but not all in the same frame. Each run
+ * picks up where the last one left off and processes records until it runs out of budget. Once every record has been
+ * visited, OnSweepFinished is called and the next run starts over.
+ *
+ * The cursor is kept in sync when records are removed: a record that RemoveAtSwap moves from ahead of the cursor to
+ * behind it is queued and still gets visited during the current sweep. Records added during a sweep are visited if the
+ * cursor hasn't finished their set yet.
+ *
+ * Subclasses should not add or remove records from inside ProcessRecords. Collect the handles and remove them once
+ * ProcessRecords returns (ie: in PostProcessRecords).
+ */
+UCLASS(Abstract)
+class M2RUNTIME_API UM2TimeSlicedOperation : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	static constexpr int32 kUnlimitedRecords = -1;
+	static constexpr float kUnlimitedTime = -1.0f;
+	
+	virtual void Initialize(UM2Registry* Registry) override;
+	virtual void BeginDestroy() override;
+
+	// The maximum number of records to process per run.
+	UPROPERTY(EditAnywhere)
+	int32 RecordBudget = 1024;
+
+	// The maximum amount of time to spend per run, in microseconds. This is checked every TimeCheckInterval records, so
+	// a run can go over by up to that many records.
+	UPROPERTY(EditAnywhere)
+	float TimeBudgetMicroseconds = kUnlimitedTime;
+
+	UPROPERTY(EditAnywhere)
+	int32 TimeCheckInterval = 64;
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override;
+
+	// Fill these in to select the record sets to sweep. Called once from Initialize.
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) {}
+
+	// Processes the records in [StartIndex, EndIndex) of RecordSet.
+	virtual void ProcessRecords(FM2OperationContext& Ctx, UM2RecordSet& RecordSet, int32 StartIndex, int32 EndIndex);
+
+	// Called at the end of every run, after all calls to ProcessRecords. It is safe to add and remove records here.
+	virtual void PostProcessRecords(FM2OperationContext& Ctx) {}
+
+	// Called once every record has been visited.
+	virtual void OnSweepFinished(FM2OperationContext& Ctx) {}
+
+private:
+	void HandleRecordRemoved(const FM2RecordHandle& RecordHandle, int32 RecordIndex, TWeakObjectPtr<UM2RecordSet> RecordSet);
+	
+	UPROPERTY(Transient)
+	TArray<TWeakObjectPtr<UM2RecordSet>> QuerySets;
+
+	int32 SetCursor = 0;
+	int32 RecordCursor = 0;
+
+	// Records that were moved behind the cursor before they could be visited.
+	TArray<FM2RecordHandle> PendingRecords;
+};
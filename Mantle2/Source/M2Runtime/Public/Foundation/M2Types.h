@@ -31,9 +31,13 @@
 
 #pragma once
 
+#include "StructUtils/InstancedStruct.h"
+
 #include "M2Types.generated.h"
 
 class TestSuite;
+class UM2AttributeModifierBuffer;
+class UM2EffectInstance;
 class UM2EffectManager;
 class UM2Effect;
 class UM2RecordSet;
@@ -101,12 +105,41 @@ enum class EM2EffectTriggerResponse
 	Cancel
 };
 
+// What happens to an effect when a record it refers to (its target, instigator or instance data) is removed.
+UENUM()
+enum class EM2EffectDependencyPolicy : uint8
+{
+	// Leave the effect alone.
+	Keep,
+	// Call OnCancelEffect and OnDeleteEffect, then remove the effect.
+	Cancel,
+	// Call OnDeleteEffect, then remove the effect.
+	Delete
+};
+
+// How a new application of an effect is combined with an instance of the same effect that is already active on the
+// same target.
+UENUM()
+enum class EM2EffectStackingPolicy : uint8
+{
+	// Every application creates a new effect instance.
+	Independent,
+	// The existing instance restarts its duration.
+	RefreshDuration,
+	// The existing instance gains a stack (up to MaxStacks) and restarts its duration.
+	AddStack,
+	// The existing instance takes on the magnitude and timing of the new application if it is stronger.
+	KeepStrongest
+};
+
 USTRUCT()
 struct M2RUNTIME_API FM2EffectContext
 {
 	GENERATED_BODY()
 
 public:
+	// Null while the engine runs headless (see FM2OperationContext::bHeadless). Effects that need a world should skip
+	// that part of their work.
 	UPROPERTY(Transient)
 	TObjectPtr<UWorld> World;
 
@@ -116,6 +149,25 @@ public:
 	// frame time, in seconds.
 	UPROPERTY(Transient)
 	float DeltaTime = 0.0f;
+
+	// The number of triggers this call to TickEffect represents. This is only ever greater than 1 for effects that
+	// support batched triggers while the effect manager is fast-forwarding.
+	UPROPERTY(Transient)
+	int32 TriggerCount = 1;
+
+	// Effects should write attribute changes here instead of modifying attribute fields directly. See UM2AttributeAggregator.
+	UPROPERTY(Transient)
+	TObjectPtr<UM2AttributeModifierBuffer> Modifiers;
+
+	// The effect's inline payload, stored next to its metadata. Only valid for the duration of the callback.
+	FInstancedStruct* Payload = nullptr;
+
+	// Returns the payload as PayloadType, or nullptr if the effect has no payload of that type.
+	template <typename PayloadType>
+	PayloadType* GetPayload() const
+	{
+		return Payload ? Payload->GetMutablePtr<PayloadType>() : nullptr;
+	}
 };
 
 USTRUCT(BlueprintType)
@@ -127,6 +179,7 @@ struct M2RUNTIME_API FM2EffectMetadata
 public:
 	static constexpr int kUnlimitedTriggers = -1;
 	static constexpr double kUnlimitedDuration = -1.0;
+	static constexpr int kUnlimitedStacks = -1;
 
 public:
 	static FM2EffectMetadata MakeOneTimeEffect(TSubclassOf<UM2Effect> InEffect)
@@ -175,7 +228,7 @@ public:
 
 	FM2EffectMetadata& WithInstigator(const FM2RecordHandle& RecordHandle)
 	{
-		if (State == EM2EffectState::Scheduled)
+		if (CanChangeHandles())
 		{
 			Instigator = RecordHandle;
 		}
@@ -185,7 +238,7 @@ public:
 
 	FM2EffectMetadata& WithTarget(const FM2RecordHandle& RecordHandle)
 	{
-		if (State == EM2EffectState::Scheduled)
+		if (CanChangeHandles())
 		{
 			Target = RecordHandle;
 		}
@@ -193,10 +246,22 @@ public:
 		return *this;
 	}
 
-	// A generic way of associating some record with this effect.
-	FM2EffectMetadata& WithInstanceData(const FM2RecordHandle& RecordHandle)
+	// A generic, effect-specific strength. Used by EM2EffectStackingPolicy::KeepStrongest.
+	FM2EffectMetadata& WithMagnitude(float InMagnitude)
 	{
 		if (State == EM2EffectState::Scheduled)
+		{
+			Magnitude = InMagnitude;
+		}
+
+		return *this;
+	}
+
+	// A generic way of associating some record with this effect. For small amounts of effect-specific state, prefer
+	// the inline payload (see UM2EffectInstance::AddEffect), which avoids adding and looking up a second record.
+	FM2EffectMetadata& WithInstanceData(const FM2RecordHandle& RecordHandle)
+	{
+		if (CanChangeHandles())
 		{
 			InstanceDataHandle = RecordHandle;
 		}
@@ -204,6 +269,13 @@ public:
 		return *this;
 	}
 
+	// The target, instigator and instance data can only be set until the effect is indexed (ie: added through
+	// UM2EffectInstance::AddEffect, or first processed by the effect manager). After that, they are fixed.
+	bool CanChangeHandles() const
+	{
+		return State == EM2EffectState::Scheduled && !bIndexed;
+	}
+
 	bool HasRemainingTriggers() const
 	{
 		return TriggerLimit == FM2EffectMetadata::kUnlimitedTriggers || TriggerCount < TriggerLimit;
@@ -224,6 +296,47 @@ public:
 		return TriggerCount > 0;
 	}
 
+	// Returns true if the effect is scheduled or ticking, ie: it hasn't been cancelled or finished.
+	bool IsActive() const
+	{
+		return State == EM2EffectState::Scheduled || State == EM2EffectState::Tick;
+	}
+
+	// Returns the number of triggers that have come due over the accumulated trigger time, capped by TriggerLimit and
+	// MaxDuration. This lets the effect manager fast-forward an effect over a large time step in constant time.
+	int32 GetDueTriggers() const
+	{
+		if (!HasRemainingTriggers())
+		{
+			return 0;
+		}
+		if (TriggerRateSec <= 0.0f)
+		{
+			// Effects without a trigger rate fire once per step.
+			return HasRemainingDuration() ? 1 : 0;
+		}
+
+		int64 DueTriggers = FMath::FloorToInt64(TriggerElapsedTime / TriggerRateSec);
+
+		if (TriggerLimit != FM2EffectMetadata::kUnlimitedTriggers)
+		{
+			DueTriggers = FMath::Min<int64>(DueTriggers, TriggerLimit - TriggerCount);
+		}
+		if (MaxDuration != FM2EffectMetadata::kUnlimitedDuration)
+		{
+			// Triggers fire every TriggerRateSec after the last trigger. Drop any that would land past MaxDuration.
+			const double LastTriggerTime = TotalElapsedTime - TriggerElapsedTime;
+			DueTriggers = FMath::Min<int64>(DueTriggers, FMath::FloorToInt64((MaxDuration - LastTriggerTime) / TriggerRateSec));
+		}
+
+		return static_cast<int32>(FMath::Clamp<int64>(DueTriggers, 0, MAX_int32));
+	}
+
+	TSubclassOf<UM2Effect> GetEffect() const
+	{
+		return Effect;
+	}
+
 	FM2RecordHandle GetInstigator() const
 	{
 		return Instigator;
@@ -239,7 +352,25 @@ public:
 		return InstanceDataHandle;
 	}
 
+	float GetMagnitude() const
+	{
+		return Magnitude;
+	}
+
+	// How long the effect has been running. For effects that finished during a fast-forward, this stops at the point
+	// where the effect ended rather than at the end of the step.
+	float GetTotalElapsedTime() const
+	{
+		return TotalElapsedTime;
+	}
+
+	int32 GetStackCount() const
+	{
+		return StackCount;
+	}
+
 protected:
+	friend UM2EffectInstance;
 	friend UM2EffectManager;
 
 	bool IsReadyForTick()
@@ -252,9 +383,56 @@ protected:
 		TriggerElapsedTime = 0.0f;
 	}
 
-	void PostTick()
+	// Unlike PreTick, this carries the remainder over so that no trigger time is lost across a large time step.
+	void PreTickFastForward(int32 NumTriggers)
+	{
+		TriggerElapsedTime = TriggerRateSec > 0.0f ? FMath::Max(TriggerElapsedTime - (NumTriggers * TriggerRateSec), 0.0f) : 0.0f;
+	}
+
+	// Merges a new application of the same effect into this one. Returns true if this effect took on the values of
+	// the new application, including its instigator. The caller must re-index the effect (see UM2EffectInstance).
+	// Refreshing restarts both the duration and the trigger limit.
+	bool Stack(const FM2EffectMetadata& Other, EM2EffectStackingPolicy Policy, int32 MaxStacks)
 	{
-		TriggerCount++;
+		switch (Policy)
+		{
+		case EM2EffectStackingPolicy::RefreshDuration:
+			TotalElapsedTime = 0.0f;
+			TriggerCount = 0;
+			break;
+		case EM2EffectStackingPolicy::AddStack:
+			StackCount += Other.StackCount;
+			if (MaxStacks != kUnlimitedStacks)
+			{
+				StackCount = FMath::Min(StackCount, MaxStacks);
+			}
+			TotalElapsedTime = 0.0f;
+			TriggerCount = 0;
+			break;
+		case EM2EffectStackingPolicy::KeepStrongest:
+			if (Other.Magnitude > Magnitude)
+			{
+				Magnitude = Other.Magnitude;
+				TriggerRateSec = Other.TriggerRateSec;
+				MaxDuration = Other.MaxDuration;
+				TriggerLimit = Other.TriggerLimit;
+				Instigator = Other.Instigator;
+				TotalElapsedTime = 0.0f;
+				TriggerElapsedTime = 0.0f;
+				TriggerCount = 0;
+				return true;
+			}
+			break;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+	void PostTick(int32 NumTriggers = 1)
+	{
+		TriggerCount += NumTriggers;
 
 		if (HasRemainingTriggers())
 		{
@@ -290,6 +468,12 @@ protected:
 	UPROPERTY()
 	int32 TriggerCount = 0;
 
+	UPROPERTY()
+	float Magnitude = 0.0f;
+
+	UPROPERTY()
+	int32 StackCount = 1;
+
 	UPROPERTY()
 	FM2RecordHandle Instigator = FM2RecordHandle();
 
@@ -298,4 +482,8 @@ protected:
 	
 	UPROPERTY()
 	FM2RecordHandle InstanceDataHandle = FM2RecordHandle();
+
+	// True once UM2EffectInstance has added this effect to its target/instigator indices.
+	UPROPERTY(Transient)
+	bool bIndexed = false;
 };
\ No newline at end of file
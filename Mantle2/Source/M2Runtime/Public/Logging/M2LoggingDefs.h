@@ -42,4 +42,18 @@ DECLARE_STATS_GROUP(TEXT("M2"), STATGROUP_M2Errors, STATCAT_M2);
 // Counters
 DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Entity Count"), STAT_M2_EntityCount, STATGROUP_M2, M2RUNTIME_API);
 DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Temporary Entities Created"), STAT_M2_TempararyEntitiesAdded, STATGROUP_M2, M2RUNTIME_API);
-DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Temporary Entities Removed"), STAT_M2_TempararyEntitiesRemoved, STATGROUP_M2, M2RUNTIME_API);
\ No newline at end of file
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Temporary Entities Removed"), STAT_M2_TempararyEntitiesRemoved, STATGROUP_M2, M2RUNTIME_API);
+
+// Effect system counters. These are reset every frame.
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Active Effects"), STAT_M2_ActiveEffects, STATGROUP_M2, M2RUNTIME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effect Triggers"), STAT_M2_EffectTriggers, STATGROUP_M2, M2RUNTIME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effect State Transitions"), STAT_M2_EffectStateTransitions, STATGROUP_M2, M2RUNTIME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Effect Records Deleted"), STAT_M2_EffectRecordsDeleted, STATGROUP_M2, M2RUNTIME_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Attribute Modifiers Applied"), STAT_M2_AttributeModifiersApplied, STATGROUP_M2, M2RUNTIME_API);
+
+// Engine counters. These are reset every frame.
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Operations Deferred"), STAT_M2_OperationsDeferred, STATGROUP_M2, M2RUNTIME_API);
+
+// Cycle counters. Per-effect-class cycle counters and active counts are created at runtime (see UM2Effect::GetStats).
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Effect Manager"), STAT_M2_EffectManager, STATGROUP_M2, M2RUNTIME_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Attribute Aggregator"), STAT_M2_AttributeAggregator, STATGROUP_M2, M2RUNTIME_API);
\ No newline at end of file
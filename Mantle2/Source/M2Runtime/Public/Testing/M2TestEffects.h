@@ -0,0 +1,167 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "EffectSystem/M2Attribute.h"
+#include "EffectSystem/M2Effect.h"
+#include "EffectSystem/M2EffectInstance.h"
+#include "Foundation/M2Registry.h"
+#include "Testing/M2TestTables.h"
+
+#include "M2TestEffects.generated.h"
+
+USTRUCT()
+struct FM2TestEffectPayload
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Count = 0;
+};
+
+UCLASS(HideDropdown)
+class UM2TestEffect_Counter : public UM2Effect
+{
+	GENERATED_BODY()
+
+public:
+	virtual EM2EffectTriggerResponse TickEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		NumTickCalls++;
+		NumTriggers += Ctx.TriggerCount;
+		return EM2EffectTriggerResponse::Continue;
+	}
+
+	virtual void OnCancelEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		NumCancels++;
+	}
+
+	virtual void OnDeleteEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		NumDeletes++;
+	}
+
+	int32 NumTickCalls = 0;
+	int32 NumTriggers = 0;
+	int32 NumCancels = 0;
+	int32 NumDeletes = 0;
+};
+
+UCLASS(HideDropdown)
+class UM2TestEffect_BatchedCounter : public UM2TestEffect_Counter
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool SupportsBatchedTriggers() const override { return true; }
+};
+
+UCLASS(HideDropdown)
+class UM2TestEffect_AddStack : public UM2TestEffect_Counter
+{
+	GENERATED_BODY()
+
+public:
+	UM2TestEffect_AddStack()
+	{
+		StackingPolicy = EM2EffectStackingPolicy::AddStack;
+		MaxStacks = 3;
+	}
+};
+
+UCLASS(HideDropdown)
+class UM2TestEffect_KeepStrongest : public UM2TestEffect_Counter
+{
+	GENERATED_BODY()
+
+public:
+	UM2TestEffect_KeepStrongest()
+	{
+		StackingPolicy = EM2EffectStackingPolicy::KeepStrongest;
+		bStackAcrossInstigators = true;
+	}
+};
+
+// Counts its own triggers in its inline payload.
+UCLASS(HideDropdown)
+class UM2TestEffect_Payload : public UM2Effect
+{
+	GENERATED_BODY()
+
+public:
+	virtual EM2EffectTriggerResponse TickEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		FM2TestEffectPayload* Payload = Ctx.GetPayload<FM2TestEffectPayload>();
+		if (!Payload)
+		{
+			return EM2EffectTriggerResponse::Cancel;
+		}
+
+		Payload->Count += Ctx.TriggerCount;
+		return EM2EffectTriggerResponse::Continue;
+	}
+};
+
+// Removes Magnitude health from its target every trigger.
+UCLASS(HideDropdown)
+class UM2TestEffect_Damage : public UM2Effect
+{
+	GENERATED_BODY()
+
+public:
+	virtual EM2EffectTriggerResponse TickEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		Ctx.Modifiers->AddModifier<FM2TestField_Health>(Metadata.GetTarget(), EM2AttributeModifierOp::Add, -Metadata.GetMagnitude());
+		return EM2EffectTriggerResponse::Continue;
+	}
+};
+
+// Applies NumRetaliations counter effects to its instigator when cancelled.
+UCLASS(HideDropdown)
+class UM2TestEffect_Retaliate : public UM2TestEffect_Counter
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnCancelEffect(const FM2EffectContext& Ctx, const FM2EffectMetadata& Metadata) override
+	{
+		Super::OnCancelEffect(Ctx, Metadata);
+		
+		UM2EffectInstance* EffectInstances = Ctx.Registry->GetRecordSet<UM2EffectInstance>();
+		for (int32 Count = 0; Count < NumRetaliations; ++Count)
+		{
+			EffectInstances->AddEffect(FM2EffectMetadata::MakeRecurringEffect(UM2TestEffect_Counter::StaticClass(), 1.0f).WithTarget(Metadata.GetInstigator()));
+		}
+	}
+
+	int32 NumRetaliations = 0;
+};
@@ -0,0 +1,210 @@
+﻿// Copyright © Mason Stevenson
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted (subject to the limitations in the disclaimer
+// below) provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice,
+//    this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+//    this list of conditions and the following disclaimer in the documentation
+//    and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its
+//    contributors may be used to endorse or promote products derived from
+//    this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+// THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+// CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+// NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+// OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include "Foundation/M2Broadphase.h"
+#include "Foundation/M2CoroutineOperation.h"
+#include "Foundation/M2KernelOperation.h"
+#include "Foundation/M2TimeSlicedOperation.h"
+#include "Testing/M2TestTables.h"
+
+#include "M2TestOperations.generated.h"
+
+// Sweeps over every player record, counting how many times each one was visited.
+UCLASS(HideDropdown)
+class UM2TestOperation_Sweep : public UM2TimeSlicedOperation
+{
+	GENERATED_BODY()
+
+public:
+	TMap<FM2RecordHandle, int32> VisitCounts;
+	int32 NumSweepsFinished = 0;
+
+protected:
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) override
+	{
+		OutMatch.Add(FM2TestField_Avatar::StaticStruct());
+		OutExclude.Append({FM2TestField_Door::StaticStruct(), FM2TestField_StaticEnvironment::StaticStruct()});
+	}
+	
+	virtual void ProcessRecords(FM2OperationContext& Ctx, UM2RecordSet& RecordSet, int32 StartIndex, int32 EndIndex) override
+	{
+		for (int32 RecordIndex = StartIndex; RecordIndex < EndIndex; ++RecordIndex)
+		{
+			VisitCounts.FindOrAdd(RecordSet.GetHandles()[RecordIndex])++;
+		}
+	}
+
+	virtual void OnSweepFinished(FM2OperationContext& Ctx) override
+	{
+		NumSweepsFinished++;
+	}
+};
+
+// Base for the test kernels below, which all run over the player records.
+UCLASS(Abstract, HideDropdown)
+class UM2TestKernel : public UM2KernelOperation
+{
+	GENERATED_BODY()
+
+public:
+	int32 NumChunksProcessed = 0;
+
+	virtual bool IsThreadSafe() const override { return true; }
+
+protected:
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) override
+	{
+		OutMatch.Add(FM2TestField_Avatar::StaticStruct());
+		OutExclude.Append({FM2TestField_Door::StaticStruct(), FM2TestField_StaticEnvironment::StaticStruct()});
+	}
+
+	TArrayView<FM2TestField_Avatar> GetAvatars(const FM2RecordChunk& Chunk)
+	{
+		return Chunk.RecordSet->GetFieldArray<FM2TestField_Avatar>().Slice(Chunk.StartIndex, Chunk.Num());
+	}
+};
+
+// Moves every player along X.
+UCLASS(HideDropdown)
+class UM2TestKernel_Offset : public UM2TestKernel
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void ProcessChunk(const FM2OperationContext& Ctx, const FM2RecordChunk& Chunk) override
+	{
+		NumChunksProcessed++;
+		for (FM2TestField_Avatar& Avatar : GetAvatars(Chunk))
+		{
+			Avatar.WorldPosition.X += 1.0f;
+		}
+	}
+};
+
+// Scales every player's position.
+UCLASS(HideDropdown)
+class UM2TestKernel_Scale : public UM2TestKernel
+{
+	GENERATED_BODY()
+
+protected:
+	virtual void ProcessChunk(const FM2OperationContext& Ctx, const FM2RecordChunk& Chunk) override
+	{
+		NumChunksProcessed++;
+		for (FM2TestField_Avatar& Avatar : GetAvatars(Chunk))
+		{
+			Avatar.WorldPosition *= 2.0f;
+		}
+	}
+};
+
+// Records how far its task got, so tests can check where it suspends.
+UCLASS(HideDropdown)
+class UM2TestOperation_Coroutine : public UM2CoroutineOperation
+{
+	GENERATED_BODY()
+
+public:
+	FGraphEventRef Event;
+	TArray<FName> Steps;
+
+protected:
+	virtual FM2OperationTask RunTask() override
+	{
+		Steps.Add(TEXT("Start"));
+		co_await FM2OperationTask::NextFrame();
+		
+		Steps.Add(TEXT("NextFrame"));
+		co_await FM2OperationTask::WaitFor(Event);
+		
+		Steps.Add(TEXT("Event"));
+		co_await FM2OperationTask::YieldIfOverBudget(1000000.0);
+		
+		Steps.Add(TEXT("Finished"));
+	}
+};
+
+// Finds overlapping players, or players overlapping doors, with a fixed extent around each record's position.
+UCLASS(HideDropdown)
+class UM2TestBroadphase : public UM2BroadphaseOperation
+{
+	GENERATED_BODY()
+
+public:
+	// Must be set before Initialize.
+	bool bAgainstDoors = false;
+
+protected:
+	virtual void GetQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) override
+	{
+		OutMatch.Add(FM2TestField_Avatar::StaticStruct());
+		OutExclude.Append({FM2TestField_Door::StaticStruct(), FM2TestField_StaticEnvironment::StaticStruct()});
+	}
+
+	virtual void GetSecondQuery(TArray<UScriptStruct*>& OutMatch, TArray<UScriptStruct*>& OutExclude) override
+	{
+		if (bAgainstDoors)
+		{
+			OutMatch.Append({FM2TestField_Avatar::StaticStruct(), FM2TestField_Door::StaticStruct()});
+		}
+	}
+
+	virtual void GetBounds(UM2RecordSet& RecordSet, TArray<FBox>& OutBounds) override
+	{
+		GetFieldBounds(RecordSet, &FM2TestField_Avatar::WorldPosition, FVector(10.0f), OutBounds);
+	}
+};
+
+// Records the context of every run, so tests can check when and how often an engine loop ran it.
+UCLASS(HideDropdown)
+class UM2TestOperation_Recorder : public UM2Operation
+{
+	GENERATED_BODY()
+
+public:
+	TArray<float> DeltaTimes;
+	TArray<float> InterpolationAlphas;
+
+	// If set, the operation's name is added to it on every run, to check the order operations ran in.
+	TArray<FName>* RunOrder = nullptr;
+
+protected:
+	virtual void PerformOperation(FM2OperationContext& Ctx) override
+	{
+		DeltaTimes.Add(Ctx.DeltaTime);
+		InterpolationAlphas.Add(Ctx.InterpolationAlpha);
+		if (RunOrder)
+		{
+			RunOrder->Add(GetFName());
+		}
+	}
+};
@@ -30,6 +30,7 @@
 // ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #pragma once
+#include "EffectSystem/M2Attribute.h"
 #include "Foundation/M2RecordSet.h"
 
 #include "M2TestTables.generated.h"
@@ -64,8 +65,17 @@ struct FM2TestField_StaticEnvironment
 public:
 	UPROPERTY()
 	float Opacity = 0.0f;
+
+	UPROPERTY()
+	FBox Bounds = FBox(ForceInit);
 };
 
+USTRUCT()
+struct FM2TestField_Health : public FM2Attribute { GENERATED_BODY() };
+
+USTRUCT()
+struct FM2TestField_Armor : public FM2Attribute { GENERATED_BODY() };
+
 USTRUCT()
 struct FMTestTag_StaticEnvironment { GENERATED_BODY() };
 
@@ -123,3 +133,17 @@ public:
 
 	M2_DECLARE_FIELD(FM2TestField_Avatar, Avatar);
 };
+
+UCLASS()
+class UM2TestSet_Character : public UM2TestRecordSet
+{
+	GENERATED_BODY()
+
+public:
+	friend TestSuite;
+	
+	virtual void Initialize() override;
+
+	M2_DECLARE_FIELD(FM2TestField_Health, Health);
+	M2_DECLARE_FIELD(FM2TestField_Armor, Armor);
+};